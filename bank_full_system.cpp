@@ -1,15 +1,49 @@
 // bank_full_system.cpp
 // Full Bank Account & Transaction System demonstrating required C++ features.
-// Compile: g++ -std=c++17 bank_full_system.cpp -o bank_system
+// Compile: g++ -std=c++17 -pthread bank_full_system.cpp -o bank_system
+//   add -DBANK_LOG_LEVEL=1 to log every account object's construction/destruction
+// Benchmarks: add -O2 -DBANK_BENCH (see section 9)
+// Coroutine API (section 6c): compile with -std=c++20
 // Run: ./bank_system
 
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iomanip>
 #include <stdexcept>
 #include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
+#include <memory>
+#include <new>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <charconv>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 using namespace std;
 
@@ -21,10 +55,279 @@ T calculateMatured(T principal, double ratePercent, int years) {
     return principal * (1 + (ratePercent/100.0) * years);
 }
 
+// --------------------------- 1a) MONEY (fixed-point amounts) ----------------------
+// Amounts are whole minor units (paise/cents) in an int64 plus a currency tag,
+// so balances never drift and can be summed exactly. Construction from double
+// rounds to the nearest minor unit; it is implicit so existing call sites such
+// as transferFunds(1001, 1002, 200.0) keep working.
+enum class Currency : uint16_t { INR = 356, USD = 840, EUR = 978 };   // ISO 4217 numeric
+
+class Money {
+private:
+    int64_t minor = 0;
+    Currency cur = Currency::INR;
+
+    void requireSameCurrency(const Money& o) const {
+        if (cur != o.cur) throw invalid_argument("Currency mismatch.");
+    }
+
+public:
+    static constexpr int64_t minorPerMajor = 100;
+
+    constexpr Money() = default;
+    Money(double major, Currency c = Currency::INR) : minor(llround(major * minorPerMajor)), cur(c) {}
+
+    static constexpr Money fromMinor(int64_t m, Currency c = Currency::INR) {
+        Money r;
+        r.minor = m;
+        r.cur = c;
+        return r;
+    }
+
+    constexpr int64_t minorUnits() const { return minor; }
+    constexpr Currency currency() const { return cur; }
+    double toDouble() const { return (double)minor / minorPerMajor; }
+    constexpr bool isNegative() const { return minor < 0; }
+    constexpr bool isPositive() const { return minor > 0; }
+
+    Money& operator+=(const Money& o) { requireSameCurrency(o); minor += o.minor; return *this; }
+    Money& operator-=(const Money& o) { requireSameCurrency(o); minor -= o.minor; return *this; }
+    friend Money operator+(Money a, const Money& b) { return a += b; }
+    friend Money operator-(Money a, const Money& b) { return a -= b; }
+    Money operator-() const { return fromMinor(-minor, cur); }
+
+    friend bool operator==(const Money& a, const Money& b) { return a.minor == b.minor && a.cur == b.cur; }
+    friend bool operator!=(const Money& a, const Money& b) { return !(a == b); }
+    // Amounts of different currencies are unequal and have no order: comparing them throws
+    friend bool operator<(const Money& a, const Money& b) { a.requireSameCurrency(b); return a.minor < b.minor; }
+    friend bool operator>(const Money& a, const Money& b) { return b < a; }
+    friend bool operator<=(const Money& a, const Money& b) { return !(b < a); }
+    friend bool operator>=(const Money& a, const Money& b) { return !(a < b); }
+
+    static constexpr size_t maxFormattedSize = 24;     // "-92233720368547758.08"
+
+    // Write toString()'s text at out, which has maxFormattedSize bytes;
+    // returns the end. No allocation.
+    char* formatTo(char* out) const {
+        uint64_t mag = minor < 0 ? 0 - (uint64_t)minor : (uint64_t)minor;
+        if (minor < 0) *out++ = '-';
+        out = to_chars(out, out + 20, mag / minorPerMajor).ptr;
+        unsigned frac = (unsigned)(mag % minorPerMajor);
+        *out++ = '.';
+        *out++ = (char)('0' + frac / 10);
+        *out++ = (char)('0' + frac % 10);
+        return out;
+    }
+
+    // "-12.05" style, always two decimals
+    string toString() const {
+        char buf[maxFormattedSize];
+        return string(buf, formatTo(buf));
+    }
+
+    // Exact decimal parse ("1500", "1500.5", "1500.000000"); digits past the
+    // second decimal round half away from zero. Surrounding blanks are ignored.
+    static bool tryParse(string_view s, Money& out, Currency c = Currency::INR) {
+        size_t i = 0, end = s.size();
+        while (i < end && (s[i] == ' ' || s[i] == '\t')) ++i;
+        while (end > i && (s[end - 1] == ' ' || s[end - 1] == '\t' || s[end - 1] == '\r')) --end;
+        bool neg = false;
+        if (i < end && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+        const int64_t maxMajor = numeric_limits<int64_t>::max() / minorPerMajor;
+        int64_t major = 0, frac = 0;
+        int digits = 0, fracDigits = 0;
+        bool roundUp = false;
+        for (; i < end && s[i] >= '0' && s[i] <= '9'; ++i, ++digits) {
+            int digit = s[i] - '0';
+            if (major > (maxMajor - digit) / 10) return false;
+            major = major * 10 + digit;
+        }
+        if (i < end && s[i] == '.') {
+            for (++i; i < end && s[i] >= '0' && s[i] <= '9'; ++i, ++digits, ++fracDigits) {
+                if (fracDigits < 2) frac = frac * 10 + (s[i] - '0');
+                else if (fracDigits == 2) roundUp = s[i] >= '5';
+            }
+        }
+        if (digits == 0 || i != end) return false;
+        for (int k = fracDigits; k < 2; ++k) frac *= 10;
+        int64_t m;
+        if (__builtin_mul_overflow(major, minorPerMajor, &m) || __builtin_add_overflow(m, frac + (roundUp ? 1 : 0), &m))
+            return false;
+        out = fromMinor(neg ? -m : m, c);
+        return true;
+    }
+
+    static Money parse(const string& s, Currency c = Currency::INR) {
+        Money m;
+        if (!tryParse(s, m, c)) throw invalid_argument("Malformed amount: " + s);
+        return m;
+    }
+
+    friend ostream& operator<<(ostream& os, const Money& m) { return os << m.toString(); }
+};
+
+// Exact simple interest on minor units: the rate is taken in parts per million
+// and the result rounds half away from zero
+template<>
+inline Money calculateMatured<Money>(Money principal, double ratePercent, int years) {
+    __int128 ppm = (__int128)llround(ratePercent * 10000.0) * years;
+    __int128 interest = (__int128)principal.minorUnits() * ppm;
+    interest = (interest + (interest >= 0 ? 500000 : -500000)) / 1000000;
+    return Money::fromMinor(principal.minorUnits() + (int64_t)interest, principal.currency());
+}
+
+// --------------------------- 1b) LOGGING ------------------------------------------
+// Diagnostic logging is selected at compile time with BANK_LOG_LEVEL. At the
+// default level 0 every log statement sits in a discarded `if constexpr`
+// branch, so production builds contain no logging code at all. When enabled,
+// messages are appended to a buffer that a background thread writes to stderr,
+// so the caller never blocks on console I/O (and output may trail cout).
+#ifndef BANK_LOG_LEVEL
+#define BANK_LOG_LEVEL 0
+#endif
+
+constexpr int logLevel = BANK_LOG_LEVEL;
+constexpr int logLifecycle = 1;        // BankAccount construction/destruction
+
+// write() the whole buffer, retrying on short writes and EINTR
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+class AsyncLogger {
+private:
+    mutex m;
+    condition_variable wake;
+    string pending;          // filled by callers
+    string inflight;         // being written; swapped with pending per batch
+    bool stopping = false;
+    thread writer;
+
+    AsyncLogger() : writer(&AsyncLogger::run, this) {}
+
+    void run() {
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            wake.wait(lk, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) break;  // stopping and drained
+            inflight.clear();
+            inflight.swap(pending);
+            lk.unlock();
+            writeAll(STDERR_FILENO, inflight.data(), inflight.size());
+            lk.lock();
+        }
+    }
+
+    void appendPart(string_view part) { pending.append(part.data(), part.size()); }
+    void appendPart(int v) {
+        char buf[16];
+        auto r = to_chars(buf, buf + sizeof buf, v);
+        pending.append(buf, r.ptr);
+    }
+
+public:
+    static AsyncLogger& instance() {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    ~AsyncLogger() {
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+
+    // Append the concatenation of parts as one message
+    template<typename... Parts>
+    void write(const Parts&... parts) {
+        lock_guard<mutex> lk(m);
+        bool wasIdle = pending.empty();
+        (appendPart(parts), ...);
+        if (wasIdle) wake.notify_one();
+    }
+};
+
+// --------------------------- 1c) THREAD POOL --------------------------------------
+// Fixed set of worker threads draining a FIFO of tasks. submit() returns a
+// future that becomes ready when the task has run and rethrows anything the
+// task threw. The destructor runs the tasks already queued, then joins.
+class ThreadPool {
+private:
+    mutex m;
+    condition_variable wake;
+    deque<function<void()>> tasks;
+    bool stopping = false;
+    vector<thread> workers;
+
+    void run() {
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            wake.wait(lk, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) break;  // stopping and drained
+            function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lk.unlock();
+            task();
+            lk.lock();
+        }
+    }
+
+public:
+    // threads == 0 means one per hardware thread
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        workers.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::run, this);
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    template<typename F>
+    future<void> submit(F&& f) {
+        auto task = make_shared<packaged_task<void()>>(std::forward<F>(f));
+        future<void> done = task->get_future();
+        post([task] { (*task)(); });
+        return done;
+    }
+
+    // Fire and forget: no future, so task must not throw
+    void post(function<void()> task) {
+        {
+            lock_guard<mutex> lk(m);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+};
+
 // --------------------------- 2) ABSTRACT BASE (Requirement 6) ---------------------
 class AccountBase {
 public:
-    virtual void display() = 0; // pure virtual -> abstract class
+    virtual void display() const = 0; // pure virtual -> abstract class
     virtual ~AccountBase() {}
 };
 
@@ -34,6 +337,10 @@ protected:
     string name;                  // protected (accessible to derived classes)
 public:
     Person(const string& n = "Unknown") : name(n) {}
+    Person(const Person&) = default;
+    Person(Person&&) noexcept = default;
+    Person& operator=(const Person&) = default;
+    Person& operator=(Person&&) noexcept = default;
     virtual ~Person() {}
 };
 
@@ -52,95 +359,312 @@ class Transaction {
 private:
     int fromAcc;
     int toAcc;
-    double amount;
+    Money amount;
     string note;
 public:
-    Transaction(int f=0, int t=0, double a=0.0, const string& n="") :
+    Transaction(int f=0, int t=0, Money a=Money(), const string& n="") :
         fromAcc(f), toAcc(t), amount(a), note(n) {}
 
+    int getFromAcc() const { return fromAcc; }
+    int getToAcc() const { return toAcc; }
+    Money getAmount() const { return amount; }
+    const string& getNote() const { return note; }
+
+    // safe simple textual record format: from|to|amount|note
     string toRecord() const {
-        // safe simple textual record format: from|to|amount|note
-        return to_string(fromAcc) + "|" + to_string(toAcc) + "|" + to_string(amount) + "|" + note + "\n";
+        string rec;
+        appendRecord(rec);
+        return rec;
+    }
+
+    // Upper bound of the record's length, for formatRecord
+    size_t maxRecordSize() const { return 2 * 11 + Money::maxFormattedSize + note.size() + 4; }
+
+    // Write the record at out (maxRecordSize() bytes); returns the end
+    char* formatRecord(char* out) const {
+        out = to_chars(out, out + 11, fromAcc).ptr;
+        *out++ = '|';
+        out = to_chars(out, out + 11, toAcc).ptr;
+        *out++ = '|';
+        out = amount.formatTo(out);
+        *out++ = '|';
+        out = copy(note.begin(), note.end(), out);
+        *out++ = '\n';
+        return out;
+    }
+
+    // Append the record to out; a reused buffer makes this allocation-free
+    void appendRecord(string& out) const {
+        size_t at = out.size();
+        out.resize(at + maxRecordSize());
+        out.resize((size_t)(formatRecord(&out[at]) - out.data()));
+    }
+
+    // Parse a record line into this transaction, reusing the note's storage:
+    // no allocation once the note has grown to fit. False (this unchanged) if malformed.
+    bool assignRecord(string_view rec) {
+        int f, t;
+        Money a;
+        string_view n;
+        if (!tryParseRecord(rec, f, t, a, n)) return false;
+        fromAcc = f;
+        toAcc = t;
+        amount = a;
+        note.assign(n.data(), n.size());
+        return true;
+    }
+
+    // Allocation-free parse of a record line (without its newline); the note
+    // is a view into rec. False if the line is malformed.
+    static bool tryParseRecord(string_view rec, int& from, int& to, Money& amount, string_view& note) {
+        size_t p1 = rec.find('|');
+        size_t p2 = p1 == string_view::npos ? p1 : rec.find('|', p1 + 1);
+        size_t p3 = p2 == string_view::npos ? p2 : rec.find('|', p2 + 1);
+        if (p3 == string_view::npos) return false;
+        auto number = [&](size_t lo, size_t hi, int& out) {
+            const char* first = rec.data() + lo;
+            const char* last = rec.data() + hi;
+            while (first < last && *first == ' ') ++first;
+            auto r = from_chars(first, last, out);
+            return r.ec == errc() && r.ptr == last;
+        };
+        if (!number(0, p1, from) || !number(p1 + 1, p2, to)) return false;
+        if (!Money::tryParse(rec.substr(p2 + 1, p3 - (p2 + 1)), amount)) return false;
+        note = rec.substr(p3 + 1);
+        return true;
+    }
+
+    static Transaction fromRecord(const string& rec) {
+        // Format: from|to|amount|note (note is the rest of the line)
+        size_t p1 = rec.find('|');
+        size_t p2 = rec.find('|', p1 + 1);
+        size_t p3 = rec.find('|', p2 + 1);
+        if (p3 == string::npos) throw invalid_argument("Malformed transaction record.");
+        int f = stoi(rec.substr(0, p1));
+        int t = stoi(rec.substr(p1 + 1, p2 - (p1 + 1)));
+        Money a = Money::parse(rec.substr(p2 + 1, p3 - (p2 + 1)));
+        return Transaction(f, t, a, rec.substr(p3 + 1));
+    }
+};
+
+// --------------------------- 4b) OPERATION STATUS --------------------------------
+// Outcome of a balance change. The in-place API reports these instead of
+// throwing, so a rejected withdrawal costs no allocation or unwinding.
+enum class TxStatus {
+    Ok,
+    InvalidAmount,
+    InsufficientFunds,
+    CurrencyMismatch,
+    AccountNotFound,
+    QueueFull                  // rejected by a full TransferQueue, never attempted
+};
+
+inline const char* statusMessage(TxStatus st) {
+    switch (st) {
+    case TxStatus::Ok: return "OK";
+    case TxStatus::InvalidAmount: return "Invalid amount";
+    case TxStatus::InsufficientFunds: return "Insufficient funds";
+    case TxStatus::CurrencyMismatch: return "Currency mismatch";
+    case TxStatus::AccountNotFound: return "Account not found";
+    case TxStatus::QueueFull: return "Transfer queue full";
+    }
+    return "Unknown status";
+}
+
+// Expected-style result: either a value or the TxStatus explaining its absence.
+// Business outcomes travel through this; exceptions are left for I/O failures.
+template<typename T>
+class Result {
+private:
+    TxStatus st;
+    T val;
+public:
+    Result(T v) : st(TxStatus::Ok), val(std::move(v)) {}
+    Result(TxStatus s) : st(s), val() {}
+
+    bool ok() const { return st == TxStatus::Ok; }
+    explicit operator bool() const { return ok(); }
+    TxStatus status() const { return st; }
+    const T& value() const {
+        if (!ok()) throw logic_error(string("Result has no value: ") + statusMessage(st));
+        return val;
+    }
+    T valueOr(T fallback) const { return ok() ? val : std::move(fallback); }
+};
+
+template<>
+class Result<void> {
+private:
+    TxStatus st;
+public:
+    Result(TxStatus s = TxStatus::Ok) : st(s) {}
+    bool ok() const { return st == TxStatus::Ok; }
+    explicit operator bool() const { return ok(); }
+    TxStatus status() const { return st; }
+};
+
+// --------------------------- 4c) ACCOUNT RECORD ----------------------------------
+// Flat, trivially copyable account state: the unit that storage and the
+// transfer path deal in. No vptrs, no virtual-base offsets and no heap-owning
+// members, so four records share a cache line and arrays of them can be
+// memcpy'd or mapped straight from a file. The name lives outside the record
+// (the table's name pool, the snapshot's name heap). BankAccount and its
+// polymorphic bases remain the view layer used for display.
+struct AccountRecord {
+    int64_t balance;             // Money minor units
+    int32_t accNumber;
+    uint16_t currency;           // Currency (ISO 4217 numeric)
+    uint16_t product;            // interest product code, 0 = default (was reserved, always zero)
+
+    Money money() const { return Money::fromMinor(balance, (Currency)currency); }
+
+    static AccountRecord make(int accNumber, Money bal) {
+        AccountRecord r;
+        r.balance = bal.minorUnits();
+        r.accNumber = accNumber;
+        r.currency = (uint16_t)bal.currency();
+        r.product = 0;
+        return r;
     }
 };
 
+static_assert(sizeof(AccountRecord) == 16, "AccountRecord must stay 16 bytes (4 per cache line)");
+static_assert(is_standard_layout<AccountRecord>::value, "AccountRecord must be standard-layout");
+static_assert(is_trivially_copyable<AccountRecord>::value, "AccountRecord must be trivially copyable");
+
 // --------------------------- 5) BANK ACCOUNT CLASS --------------------------------
 // Demonstrates: class design, public/private/protected, constructors/destructors,
 // operator overloading, function overloading, default args, pass-by-ref & return-by-ref,
 // implements pure virtual display() from AccountBase.
 class BankAccount : public Person, public BankBase {
 private:
-    double balance;               // private member (encapsulation)
+    Money balance;                // private member (encapsulation)
 
 public:
     // Constructor (Requirement 2)
-    BankAccount(const string& n = "Unknown", int acc = 0, double bal = 0.0) :
+    BankAccount(const string& n = "Unknown", int acc = 0, Money bal = Money()) :
         Person(n), BankBase(acc), balance(bal) {
-        cout << "[Constructor] Account created: " << accNumberInfo() << "\n";
+        if constexpr (logLevel >= logLifecycle)
+            AsyncLogger::instance().write("[Constructor] Account created: ", accNumber, " (", name, ")\n");
     }
 
+    // View over a flat record and its name
+    BankAccount(const AccountRecord& r, string_view n) : BankAccount(string(n), r.accNumber, r.money()) {}
+
+    AccountRecord record() const { return AccountRecord::make(accNumber, balance); }
+
+    // Copies duplicate the name; moves steal it, so temporaries and vector
+    // growth cost no heap allocation
+    BankAccount(const BankAccount&) = default;
+    BankAccount(BankAccount&&) noexcept = default;
+    BankAccount& operator=(const BankAccount&) = default;
+    BankAccount& operator=(BankAccount&&) noexcept = default;
+
     // Destructor (Requirement 2)
     ~BankAccount() {
-        cout << "[Destructor] Account object for acc# " << accNumberInfo() << " destroyed.\n";
+        if constexpr (logLevel >= logLifecycle)
+            AsyncLogger::instance().write("[Destructor] Account object for acc# ", accNumber, " (", name, ") destroyed.\n");
     }
 
+    const string& getName() const { return name; }
+
     // Helper to get account summary string
     string accNumberInfo() const {
         return to_string(getAccNumber()) + " (" + name + ")";
     }
 
+    // ----------------- In-place balance changes ---------------------------------
+    // Non-throwing; the balance is untouched unless the result is Ok
+    TxStatus deposit(Money amt) {
+        if (amt.isNegative()) return TxStatus::InvalidAmount;
+        if (amt.currency() != balance.currency()) return TxStatus::CurrencyMismatch;
+        balance += amt;
+        return TxStatus::Ok;
+    }
+
+    TxStatus withdraw(Money amt) {
+        if (amt.isNegative()) return TxStatus::InvalidAmount;
+        if (amt.currency() != balance.currency()) return TxStatus::CurrencyMismatch;
+        if (balance < amt) return TxStatus::InsufficientFunds;
+        balance -= amt;
+        return TxStatus::Ok;
+    }
+
     // ----------------- 4a) Operator overloading (Requirement 4) -----------------
-    // Deposit with operator+
-    BankAccount operator+(double amt) const {
-        if (amt < 0) throw invalid_argument("Deposit amount cannot be negative.");
+    // Deposit / withdraw in place; throw like updateBalance on failure
+    BankAccount& operator+=(Money amt) {
+        raise(deposit(amt), "Deposit amount cannot be negative.");
+        return *this;
+    }
+
+    BankAccount& operator-=(Money amt) {
+        raise(withdraw(amt), "Withdrawal amount cannot be negative.");
+        return *this;
+    }
+
+    // Deposit with operator+ (copies an lvalue, reuses an rvalue)
+    BankAccount operator+(Money amt) const& {
         BankAccount temp = *this;
-        temp.balance += amt;
+        temp += amt;
         return temp;
     }
 
+    BankAccount operator+(Money amt) && {
+        *this += amt;
+        return std::move(*this);
+    }
+
     // Withdraw with operator-
-    BankAccount operator-(double amt) const {
-        if (amt < 0) throw invalid_argument("Withdrawal amount cannot be negative.");
-        if (balance < amt) throw runtime_error("Insufficient balance for withdrawal.");
+    BankAccount operator-(Money amt) const& {
         BankAccount temp = *this;
-        temp.balance -= amt;
+        temp -= amt;
         return temp;
     }
 
+    BankAccount operator-(Money amt) && {
+        *this -= amt;
+        return std::move(*this);
+    }
+
     // Stream output operator for convenience (friend)
     friend ostream& operator<<(ostream& os, const BankAccount& acc) {
         os << "Acc#: " << acc.accNumber << " | Name: " << acc.name
-           << " | Balance: " << fixed << setprecision(2) << acc.balance;
+           << " | Balance: " << acc.balance;
         return os;
     }
 
     // ----------------- 7) Function overloading (Requirement 7) -----------------
     // deposit version (single-arg)
-    void updateBalance(double amt) {
-        if (amt < 0) throw invalid_argument("Amount cannot be negative.");
-        balance += amt;
+    void updateBalance(Money amt) {
+        raise(deposit(amt), "Amount cannot be negative.");
     }
     // overloaded updateBalance: can withdraw if withdraw==true
-    void updateBalance(double amt, bool withdraw) {
-        if (amt < 0) throw invalid_argument("Amount cannot be negative.");
-        if (withdraw) {
-            if (balance < amt) throw runtime_error("Insufficient balance for withdrawal.");
-            balance -= amt;
-        } else {
-            balance += amt;
+    void updateBalance(Money amt, bool withdrawal) {
+        raise(withdrawal ? withdraw(amt) : deposit(amt), "Amount cannot be negative.");
+    }
+
+    // Map a failed status onto the exceptions of the throwing API
+    static void raise(TxStatus st, const char* invalidAmountMsg) {
+        switch (st) {
+        case TxStatus::Ok: return;
+        case TxStatus::InvalidAmount: throw invalid_argument(invalidAmountMsg);
+        case TxStatus::InsufficientFunds: throw runtime_error("Insufficient balance for withdrawal.");
+        case TxStatus::CurrencyMismatch: throw invalid_argument("Currency mismatch.");
+        case TxStatus::AccountNotFound: throw runtime_error("Account not found.");
+        case TxStatus::QueueFull: throw runtime_error("Transfer queue is full.");
         }
     }
 
     // ----------------- Default argument (Requirement 7) -------------------------
     void showDetails(bool full = true) const {
         cout << "Account Number: " << accNumber << " | Name: " << name;
-        if (full) cout << " | Balance: " << fixed << setprecision(2) << balance;
+        if (full) cout << " | Balance: " << balance;
         cout << "\n";
     }
 
     // ----------------- Pass-by-reference & Return-by-reference ------------------
-    double& getBalanceRef() { return balance; }              // return by reference
-    const double& getBalanceConstRef() const { return balance; }
+    Money& getBalanceRef() { return balance; }               // return by reference
+    const Money& getBalanceConstRef() const { return balance; }
 
     // ----------------- Required ctor/dtor, and implement pure virtual -----------
     void display() const override {
@@ -148,197 +672,6254 @@ public:
     }
 
     // For file handling (serialize/deserialize)
+    // Name can include spaces; use '|' separator
     string toRecord() const {
-        // Name can include spaces; use '|' separator
-        return name + "|" + to_string(accNumber) + "|" + to_string(balance) + "\n";
+        string rec;
+        appendRecord(rec, name, accNumber, balance);
+        return rec;
     }
 
-    static BankAccount fromRecord(const string& rec) {
-        // Format: name|acc|balance
+    // name|acc|balance plus newline appended to out without a temporary;
+    // shared with listings that never build a BankAccount
+    static void appendRecord(string& out, string_view name, int acc, Money bal) {
+        size_t at = out.size();
+        out.resize(at + name.size() + 11 + Money::maxFormattedSize + 3);
+        char* p = &out[at];
+        p = copy(name.begin(), name.end(), p);
+        *p++ = '|';
+        p = to_chars(p, p + 11, acc).ptr;
+        *p++ = '|';
+        p = bal.formatTo(p);
+        *p++ = '\n';
+        out.resize((size_t)(p - out.data()));
+    }
+
+    // Allocation-free parse of name|acc|balance; name views into rec
+    static bool tryParseRecord(string_view rec, string_view& n, int& acc, Money& bal) {
         size_t p1 = rec.find('|');
+        if (p1 == string_view::npos) return false;
         size_t p2 = rec.find('|', p1 + 1);
-        string n = rec.substr(0, p1);
-        int acc = stoi(rec.substr(p1 + 1, p2 - (p1 + 1)));
-        double bal = stod(rec.substr(p2 + 1));
-        return BankAccount(n, acc, bal);
+        if (p2 == string_view::npos) return false;
+        const char* first = rec.data() + p1 + 1;
+        const char* last = rec.data() + p2;
+        while (first < last && *first == ' ') ++first;
+        auto r = from_chars(first, last, acc);
+        if (r.ec != errc() || r.ptr != last) return false;
+        if (!Money::tryParse(rec.substr(p2 + 1), bal)) return false;
+        n = rec.substr(0, p1);
+        return true;
+    }
+
+    static BankAccount fromRecord(const string& rec) {
+        // Format: name|acc|balance
+        string_view n;
+        int acc;
+        Money bal;
+        if (!tryParseRecord(rec, n, acc, bal)) throw invalid_argument("Malformed account record.");
+        return BankAccount(string(n), acc, bal);
     }
 };
 
-// --------------------------- 6) ACCOUNT MANAGER (File handling) ------------------
-// Demonstrates file handling to store & retrieve data (Requirement 8)
-class AccountManager {
+// --------------------------- 5a) COLUMNAR ACCOUNT TABLE --------------------------
+// The resident store behind AccountManager. Each field lives in its own array
+// (struct of arrays), so scans over balances touch nothing but balances, and
+// names are interned once in an arena. A slot is an account's row number.
+// BankAccount objects are only materialised when a caller asks for one.
+
+// Open-addressing hash table (linear probing) from account number to slot.
+// Entries sit in one flat array, so a lookup is usually a single cache miss
+// and inserting costs no allocation until the table has to grow.
+class AccountIndex {
 private:
-    const string accountsFile = "accounts.txt";
-    const string transactionsFile = "transactions.txt";
+    struct Entry {
+        int32_t key;
+        uint32_t value;                       // empty when == emptyValue
+    };
+    static constexpr uint32_t emptyValue = numeric_limits<uint32_t>::max();
+    vector<Entry> entries;
+    size_t used = 0;
+    unsigned bits = 0;
 
-public:
-    // Create or append account to file
-    void createAccount(const BankAccount& acc) {
-        ofstream ofs(accountsFile, ios::app);
-        if (!ofs) throw runtime_error("Unable to open accounts file for writing.");
-        ofs << acc.toRecord();
-        ofs.close();
+    size_t home(int32_t key) const {
+        return (size_t)(((uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
     }
 
-    // Load all accounts from file
-    vector<BankAccount> loadAllAccounts() {
-        vector<BankAccount> list;
-        ifstream ifs(accountsFile);
-        if (!ifs) return list; // file might not exist yet
-        string line;
-        while (getline(ifs, line)) {
-            if (line.empty()) continue;
-            try {
-                BankAccount a = BankAccount::fromRecord(line);
-                list.push_back(a);
-            } catch (...) {
-                // ignore malformed lines
-            }
+    void rehash(unsigned newBits) {
+        vector<Entry> old;
+        old.swap(entries);
+        bits = newBits;
+        entries.assign(size_t(1) << bits, Entry{0, emptyValue});
+        size_t mask = entries.size() - 1;
+        for (const Entry& e : old) {
+            if (e.value == emptyValue) continue;
+            size_t i = home(e.key);
+            while (entries[i].value != emptyValue) i = (i + 1) & mask;
+            entries[i] = e;
         }
-        ifs.close();
-        return list;
     }
 
-    // Save all accounts (overwrite)
-    void saveAllAccounts(const vector<BankAccount>& accounts) {
-        ofstream ofs(accountsFile);
-        if (!ofs) throw runtime_error("Unable to open accounts file for writing.");
-        for (const auto& a : accounts) ofs << a.toRecord();
-        ofs.close();
+public:
+    static constexpr uint32_t missing = emptyValue;
+
+    // Make room for n keys at a load factor of at most 1/2
+    void reserve(size_t n) {
+        unsigned need = 4;
+        while ((size_t(1) << need) < 2 * n) ++need;
+        if (need > bits) rehash(need);
     }
 
-    // Find account index by account number
-    int findAccountIndex(vector<BankAccount>& list, int accNo) {
-        for (size_t i = 0; i < list.size(); ++i) {
-            if (list[i].getAccNumber() == accNo) return (int)i;
+    uint32_t find(int32_t key) const {
+        if (entries.empty()) return missing;
+        size_t mask = entries.size() - 1;
+        for (size_t i = home(key);; i = (i + 1) & mask) {
+            const Entry& e = entries[i];
+            if (e.value == emptyValue) return missing;
+            if (e.key == key) return e.value;
         }
-        return -1;
     }
 
-    // Transfer funds (shows objects passed & returned and exception handling)
-    bool transferFunds(int fromAcc, int toAcc, double amount) {
-        if (amount <= 0) throw invalid_argument("Transfer amount must be positive.");
-        vector<BankAccount> list = loadAllAccounts();
-        int idxFrom = findAccountIndex(list, fromAcc);
-        int idxTo = findAccountIndex(list, toAcc);
-        if (idxFrom == -1 || idxTo == -1) throw runtime_error("Source or destination account not found.");
-
-        // Check balance
-        if (list[idxFrom].getBalanceConstRef() < amount) throw runtime_error("Insufficient funds in source account.");
-
-        // Perform transfer using overloaded functions
-        list[idxFrom].updateBalance(amount, true); // withdraw
-        list[idxTo].updateBalance(amount);         // deposit
-
-        // Save transaction record
-        Transaction tx(fromAcc, toAcc, amount, "transfer");
-        ofstream ofs(transactionsFile, ios::app);
-        if (!ofs) throw runtime_error("Unable to write transaction file.");
-        ofs << tx.toRecord();
-        ofs.close();
-
-        // rewrite accounts file
-        saveAllAccounts(list);
-        return true;
+    // Insert a key that is not present yet
+    void insert(int32_t key, uint32_t value) {
+        if (2 * (used + 1) > entries.size()) rehash(bits ? bits + 1 : 4);
+        size_t mask = entries.size() - 1;
+        size_t i = home(key);
+        while (entries[i].value != emptyValue) i = (i + 1) & mask;
+        entries[i] = Entry{key, value};
+        ++used;
     }
 
-    // Utility: deposit using object pass & return
-    BankAccount depositToAccount(BankAccount acc, double amount) {
-        // acc passed by value (object passed) and returned by value (object returned)
-        if (amount <= 0) throw invalid_argument("Deposit amount must be positive.");
-        acc = acc + amount; // uses operator+
-        return acc;
+    // Start loading key's home entry into the cache ahead of find(key)
+    void prefetch(int32_t key) const {
+        if (!entries.empty()) __builtin_prefetch(&entries[home(key)]);
     }
 
-    // Utility: withdraw by reference (pass-by-reference)
-    void withdrawFromAccount(vector<BankAccount>& list, int accNo, double amount) {
-        int idx = findAccountIndex(list, accNo);
-        if (idx == -1) throw runtime_error("Account not found.");
-        // use operator- via assignment
-        list[idx] = list[idx] - amount;
+    void clear() {
+        entries.clear();
+        used = 0;
+        bits = 0;
     }
 };
 
-// --------------------------- 7) UTILITY FUNCTION (pass/return objects) ----------
-BankAccount giveSignupBonus(BankAccount acc) {
-    // Example of object passed & returned
-    acc.updateBalance(100.0); // bonus
-    return acc;
-}
+// Small front cache over AccountIndex for the accounts that take most of the
+// traffic. Sets of eight (accNumber, slot) entries fill one 64-byte line, so
+// a hit is one probe of a line that stays in L2 while the index itself is far
+// larger than the caches. Eviction is CLOCK within a set: a hit sets the
+// entry's referenced bit (only when clear, so hits on hot entries write
+// nothing), and the hand evicts the first entry without one. Admission wants
+// a second miss within a doorkeeper period (a bitmap cleared after twice
+// capacity() misses on this cache), so one-off lookups of cold accounts do not
+// push hot ones out. Every entry is a single atomic word holding a pair that
+// is valid for the current layout, so threads look up and admit with plain
+// loads and stores: a racing update can only lose an admission or a
+// referenced bit, never produce a wrong slot. Locked read-modify-writes are
+// avoided on purpose -- they would stall the CPU's overlapping of misses.
+// clear() must not race with lookups.
+class AccountCache {
+private:
+    static constexpr unsigned ways = 8;
+    static constexpr uint64_t empty = ~0ull;
+    static constexpr uint32_t maxSlot = 0x7fffffff;     // the slot shares its word with the referenced bit
+    struct alignas(64) Set { atomic<uint64_t> entries[ways]; };
+    unique_ptr<Set[]> sets;
+    unique_ptr<atomic<uint8_t>[]> hands;
+    unique_ptr<atomic<uint64_t>[]> doorkeeper;
+    size_t setMask;
+    size_t doorkeeperMask;                              // in bits
+    uint32_t doorkeeperPeriod;                          // misses between doorkeeper resets
+    alignas(64) atomic<uint32_t> misses{0};             // since the last reset; racing counts may be lost
 
-// --------------------------- 8) MAIN: demonstration & simple menu ---------------
-int main() {
-    AccountManager mgr;
-    try {
-        cout << "=== Bank Account & Transaction System (Demo) ===\n\n";
+    static uint64_t hashOf(int32_t key) { return (uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ull; }
+    static uint64_t entryOf(int32_t key, uint32_t slot) { return ((uint64_t)(uint32_t)key << 32) | ((uint64_t)slot << 1); }
+    Set& setOf(uint64_t h) const { return sets[(h >> 40) & setMask]; }
 
-        // 1) Create sample accounts and persist them
-        cout << "[Demo] Creating sample accounts (Alice, Bob)...\n";
-        BankAccount a1("Alice", 1001, 1500.0);
-        BankAccount a2("Bob",   1002, 800.0);
+public:
+    static constexpr size_t minEntries = 16384, maxEntries = 131072;   // 128 KB .. 1 MB of sets
 
-        // Save to file
-        mgr.createAccount(a1);
-        mgr.createAccount(a2);
+    // Sized for a table of `accounts`: about one entry per 64 accounts, so
+    // the busiest 1-2% fit; a power of two multiple of the set size
+    explicit AccountCache(size_t accounts) {
+        size_t entries = min(maxEntries, max(minEntries, accounts / 64));
+        size_t n = 1;
+        while (n * ways < entries) n <<= 1;
+        sets.reset(new Set[n]);
+        hands.reset(new atomic<uint8_t>[n]);
+        setMask = n - 1;
+        size_t words = n * ways * 16 / 64;           // sixteen doorkeeper bits per entry
+        doorkeeper.reset(new atomic<uint64_t>[words]);
+        doorkeeperMask = words * 64 - 1;
+        doorkeeperPeriod = (uint32_t)(2 * n * ways);          // a hot account comes back well within it
+        clear();
+    }
 
-        // 2) Display (abstract override + operator<<)
-        cout << "\n[Demo] Displaying created accounts:\n";
-        a1.display();
-        a2.display();
+    size_t capacity() const { return (setMask + 1) * ways; }
 
-        // 3) Operator overloading deposit and withdraw
-        cout << "\n[Demo] Depositing 200 to Alice using operator+ ...\n";
-        a1 = a1 + 200.0; // operator+
-        cout << a1 << "\n";
+    // The cached slot of key, or AccountIndex::missing
+    uint32_t find(int32_t key) const {
+        int way;
+        uint32_t slot = probe(key, way);
+        if (slot != AccountIndex::missing) touch(key, way);
+        return slot;
+    }
 
-        cout << "[Demo] Withdrawing 100 from Alice using updateBalance(withdraw)...\n";
-        a1.updateBalance(100.0, true);
-        cout << a1 << "\n";
+    // find() without its side effect: the slot and the way holding it, for a
+    // touch() once the caller knows the lookup counts
+    uint32_t probe(int32_t key, int& way) const {
+        const Set& s = setOf(hashOf(key));
+        for (unsigned w = 0; w < ways; ++w) {
+            uint64_t e = s.entries[w].load(memory_order_relaxed);
+            if ((uint32_t)(e >> 32) != (uint32_t)key || e == empty) continue;
+            way = (int)w;
+            return (uint32_t)(e >> 1) & maxSlot;
+        }
+        return AccountIndex::missing;
+    }
 
-        // 4) Return-by-reference demo
-        double &refBal = a1.getBalanceRef(); // return by reference
-        refBal += 25.0;                       // directly update using reference
-        cout << "[Demo] After modifying via returned reference: " << a1 << "\n";
+    // Record a hit on the entry probe() found, if it still holds key
+    void touch(int32_t key, int way) const {
+        atomic<uint64_t>& entry = setOf(hashOf(key)).entries[way];
+        uint64_t e = entry.load(memory_order_relaxed);
+        if ((uint32_t)(e >> 32) == (uint32_t)key && e != empty && !(e & 1)) entry.store(e | 1, memory_order_relaxed);
+    }
 
-        // 5) Template usage
-        double matured = calculateMatured<double>(1000.0, 5.0, 2); // simple interest
-        cout << "[Demo] Template function calculateMatured: 1000 at 5% for 2 years -> " << matured << "\n";
+    // Offer a key the index just resolved; it is cached on its second miss
+    void admit(int32_t key, uint32_t slot) {
+        if (slot > maxSlot) return;
+        uint64_t h = hashOf(key);
+        uint32_t missed = misses.load(memory_order_relaxed) + 1;
+        if (missed >= doorkeeperPeriod) {
+            missed = 0;
+            for (size_t i = 0; i <= doorkeeperMask / 64; ++i) doorkeeper[i].store(0, memory_order_relaxed);
+        }
+        misses.store(missed, memory_order_relaxed);
+        uint64_t bit = (h >> 8) & doorkeeperMask;
+        uint64_t mask = 1ull << (bit & 63);
+        atomic<uint64_t>& word = doorkeeper[bit >> 6];
+        uint64_t seen = word.load(memory_order_relaxed);
+        if (!(seen & mask)) {
+            word.store(seen | mask, memory_order_relaxed);
+            return;
+        }
 
-        // 6) Process account via object pass & return
-        cout << "[Demo] Applying signup bonus to Bob (object pass/return)...\n";
-        a2 = giveSignupBonus(a2);
-        cout << a2 << "\n";
+        size_t set = (h >> 40) & setMask;
+        Set& s = sets[set];
+        unsigned hand = hands[set].load(memory_order_relaxed);
+        for (unsigned i = 0; i < 2 * ways; ++i) {
+            unsigned w = (hand + i) % ways;
+            uint64_t e = s.entries[w].load(memory_order_relaxed);
+            if (e != empty && (e & 1)) {            // referenced: second chance
+                s.entries[w].store(e & ~1ull, memory_order_relaxed);
+                continue;
+            }
+            s.entries[w].store(entryOf(key, slot), memory_order_relaxed);
+            hands[set].store((uint8_t)((w + 1) % ways), memory_order_relaxed);
+            return;
+        }
+    }
 
-        // 7) Write updated single-account objects (rewrite all)
-        vector<BankAccount> all = mgr.loadAllAccounts();
-        // update entries in file to reflect modified balances for demo
-        for (auto &acc : all) {
-            if (acc.getAccNumber() == a1.getAccNumber()) acc = a1;
-            if (acc.getAccNumber() == a2.getAccNumber()) acc = a2;
+    void clear() {
+        for (size_t i = 0; i <= setMask; ++i) {
+            for (atomic<uint64_t>& e : sets[i].entries) e.store(empty, memory_order_relaxed);
+            hands[i].store(0, memory_order_relaxed);
         }
-        mgr.saveAllAccounts(all);
+        for (size_t i = 0; i <= doorkeeperMask / 64; ++i) doorkeeper[i].store(0, memory_order_relaxed);
+        misses.store(0, memory_order_relaxed);
+    }
+};
 
-        // 8) Perform a transfer using AccountManager (file-backed)
-        cout << "\n[Demo] Transfer 200 from Alice (1001) to Bob (1002)...\n";
-        bool t = mgr.transferFunds(1001, 1002, 200.0);
-        if (t) cout << "[Demo] Transfer successful and files updated.\n";
+// Interned strings in a monotonic arena; ids and views stay valid until clear().
+// The lookup table is open-addressed as well, so interning a new name costs
+// no allocation beyond the occasional arena block or table growth.
+class NamePool {
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    size_t blockUsed = blockSize;            // forces a block on first store
+    vector<unique_ptr<char[]>> large;        // names too big to share a block
+    vector<string_view> byId;
+    vector<uint32_t> buckets;                // id + 1, 0 = empty
 
-        // 9) Exception handling demo: attempted invalid withdrawal
-        try {
-            cout << "\n[Demo] Attempting invalid withdrawal (-50) to demonstrate exception handling...\n";
-            a1.updateBalance(-50.0);
-        } catch (const exception &e) {
-            cerr << "[Caught Exception] " << e.what() << "\n";
+    string_view store(string_view s) {
+        if (s.size() > blockSize / 4) {
+            large.emplace_back(new char[s.size()]);
+            memcpy(large.back().get(), s.data(), s.size());
+            return string_view(large.back().get(), s.size());
+        }
+        if (blockUsed + s.size() > blockSize) {
+            blocks.emplace_back(new char[blockSize]);
+            blockUsed = 0;
+        }
+        char* dst = blocks.back().get() + blockUsed;
+        memcpy(dst, s.data(), s.size());
+        blockUsed += s.size();
+        return string_view(dst, s.size());
+    }
+
+    void growBuckets(size_t minBuckets) {
+        size_t n = 16;
+        while (n < minBuckets) n <<= 1;
+        buckets.assign(n, 0);
+        for (uint32_t id = 0; id < byId.size(); ++id) {
+            size_t i = hash<string_view>()(byId[id]) & (n - 1);
+            while (buckets[i]) i = (i + 1) & (n - 1);
+            buckets[i] = id + 1;
         }
+    }
 
-        // 10) Show file-backed accounts now
-        cout << "\n[Demo] Final accounts loaded from file:\n";
-        vector<BankAccount> finalList = mgr.loadAllAccounts();
-        for (const auto &x : finalList) x.display();
+public:
+    void reserve(size_t names) {
+        byId.reserve(names);
+        if (buckets.size() < 2 * names) growBuckets(2 * names);
+    }
 
-        cout << "\n=== Demo finished successfully ===\n";
-    } catch (const exception &e) {
-        cerr << "[Unhandled Exception] " << e.what() << "\n";
+    uint32_t intern(string_view s) {
+        if (2 * (byId.size() + 1) > buckets.size()) growBuckets(2 * (byId.size() + 1));
+        size_t mask = buckets.size() - 1;
+        size_t i = hash<string_view>()(s) & mask;
+        for (; buckets[i]; i = (i + 1) & mask)
+            if (byId[buckets[i] - 1] == s) return buckets[i] - 1;
+        uint32_t id = (uint32_t)byId.size();
+        byId.push_back(store(s));
+        buckets[i] = id + 1;
+        return id;
+    }
+
+    string_view get(uint32_t id) const { return byId[id]; }
+    size_t size() const { return byId.size(); }
+
+    void clear() {
+        blocks.clear();
+        large.clear();
+        blockUsed = blockSize;
+        byId.clear();
+        buckets.clear();
+    }
+};
+
+// Point-in-time copy of an AccountTable's columns. Names stay views into the
+// table's name pool of that moment, which the snapshot keeps alive, so taking
+// one copies fixed-width columns only and no name is duplicated.
+class AccountSnapshot {
+private:
+    friend class AccountTable;
+    vector<int32_t> accNumbers;
+    vector<int64_t> balances;
+    vector<uint16_t> currencies;
+    vector<uint16_t> products;
+    vector<uint32_t> nameIds;
+    vector<string_view> nameById;
+    shared_ptr<const NamePool> pool;
+    uint64_t covered = 0;
+
+public:
+    size_t size() const { return accNumbers.size(); }
+    // Log offset the snapshot is consistent with: every record before it and none after
+    uint64_t logOffset() const { return covered; }
+    void setLogOffset(uint64_t offset) { covered = offset; }
+
+    int accNumber(size_t i) const { return accNumbers[i]; }
+    string_view name(size_t i) const { return nameById[nameIds[i]]; }
+    Money balance(size_t i) const { return Money::fromMinor(balances[i], (Currency)currencies[i]); }
+    const int64_t* balanceColumn() const { return balances.data(); }
+
+    BankAccount materialize(size_t i) const {
+        AccountRecord r;
+        r.balance = balances[i];
+        r.accNumber = accNumbers[i];
+        r.currency = currencies[i];
+        r.product = products[i];
+        return BankAccount(r, name(i));
+    }
+
+    // The accounts in the legacy text format (name|acc|balance per line)
+    string toText() const {
+        string out;
+        out.reserve(size() * 32);
+        for (size_t i = 0; i < size(); ++i) BankAccount::appendRecord(out, name(i), accNumbers[i], balance(i));
+        return out;
+    }
+};
+
+class AccountTable {
+private:
+    vector<int32_t> accNumbers;
+    vector<int64_t> balances;                // Money minor units
+    vector<uint16_t> currencies;
+    vector<uint32_t> nameIds;
+    vector<uint16_t> products;               // interest product codes
+    shared_ptr<NamePool> names = make_shared<NamePool>();   // shared with snapshots
+    AccountIndex index;                      // accNumber -> slot
+    unique_ptr<AccountCache> cache;          // in front of index, once the table is large
+    // Changes since the last markClean(): a byte per slot (distinct slots can
+    // be marked from different threads) and whether rows were added or renamed
+    vector<uint8_t> dirty;
+    bool reshaped = false;
+
+public:
+    static constexpr size_t npos = numeric_limits<size_t>::max();
+
+    size_t size() const { return accNumbers.size(); }
+
+    void reserve(size_t n) {
+        accNumbers.reserve(n);
+        balances.reserve(n);
+        currencies.reserve(n);
+        nameIds.reserve(n);
+        products.reserve(n);
+        dirty.reserve(n);
+        index.reserve(n);
+    }
+
+    void clear() {
+        accNumbers.clear();
+        balances.clear();
+        currencies.clear();
+        nameIds.clear();
+        products.clear();
+        names = make_shared<NamePool>();   // a snapshot may still be reading the old pool
+        index.clear();
+        if (cache) cache->clear();
+        dirty.clear();
+        reshaped = true;
+    }
+
+    // Below this many accounts the index stays in the CPU caches by itself
+    static constexpr size_t cacheMinAccounts = 1 << 16;
+
+    // Safe from several threads at once while the layout does not change
+    size_t find(int accNumber) const {
+        if (cache) {
+            uint32_t slot = cache->find(accNumber);
+            if (slot != AccountIndex::missing) return slot;
+        }
+        uint32_t slot = index.find(accNumber);
+        if (slot == AccountIndex::missing) return npos;
+        if (cache) cache->admit(accNumber, slot);
+        return slot;
+    }
+
+    // A find() split in two for optimistic readers (LockStripes::read), whose
+    // lookup may run again: lookup() changes nothing, settle() then applies
+    // the cache bookkeeping of the run that counted, once
+    struct Lookup {
+        size_t slot;
+        int32_t accNumber;
+        int way;                             // cache way of a hit; -1 for an index hit
+    };
+
+    Lookup lookup(int accNumber) const {
+        Lookup at{npos, accNumber, -1};
+        if (cache) {
+            uint32_t slot = cache->probe(accNumber, at.way);
+            if (slot != AccountIndex::missing) {
+                at.slot = slot;
+                return at;
+            }
+        }
+        uint32_t slot = index.find(accNumber);
+        if (slot != AccountIndex::missing) at.slot = slot;
+        return at;
+    }
+
+    // Safe where find() is, with the layout unchanged since lookup()
+    void settle(const Lookup& at) const {
+        if (!cache || at.slot == npos) return;
+        if (at.way >= 0) cache->touch(at.accNumber, at.way);
+        else cache->admit(at.accNumber, (uint32_t)at.slot);
+    }
+
+    // Start fetching what find(accNumber) will read; batch lookups issue
+    // this a few rows ahead so the index misses overlap
+    void prefetch(int accNumber) const {
+        if (!cache || cache->find(accNumber) == AccountIndex::missing) index.prefetch(accNumber);
+    }
+
+    // Pre-size for n accounts with up to n distinct names
+    void reserveNames(size_t n) { names->reserve(n); }
+
+    // Insert an account, or overwrite name and balance of an existing one;
+    // returns its slot
+    size_t upsert(const AccountRecord& r, string_view name) {
+        uint32_t nameId = names->intern(name);
+        uint32_t existing = index.find(r.accNumber);
+        if (existing != AccountIndex::missing) {
+            if (balances[existing] != r.balance || currencies[existing] != r.currency ||
+                products[existing] != r.product)
+                dirty[existing] = 1;
+            if (nameIds[existing] != nameId) reshaped = true;
+            balances[existing] = r.balance;
+            currencies[existing] = r.currency;
+            nameIds[existing] = nameId;
+            products[existing] = r.product;
+            return existing;
+        }
+        uint32_t slot = (uint32_t)accNumbers.size();
+        accNumbers.push_back(r.accNumber);
+        balances.push_back(r.balance);
+        currencies.push_back(r.currency);
+        nameIds.push_back(nameId);
+        products.push_back(r.product);
+        dirty.push_back(1);
+        index.insert(r.accNumber, slot);
+        if (accNumbers.size() >= cacheMinAccounts && (!cache || cache->capacity() < accNumbers.size() / 64)
+            && (!cache || cache->capacity() < AccountCache::maxEntries))
+            cache.reset(new AccountCache(2 * accNumbers.size()));   // regrown as the table doubles
+        reshaped = true;
+        return slot;
+    }
+
+    // As above, but an existing account keeps its product code
+    size_t upsert(int accNumber, string_view name, Money bal) {
+        AccountRecord r = AccountRecord::make(accNumber, bal);
+        uint32_t existing = index.find(accNumber);
+        if (existing != AccountIndex::missing) r.product = products[existing];
+        return upsert(r, name);
+    }
+
+    // balance and product are loaded atomically: LockStripes::read callers
+    // run this while a transfer may be writing them
+    AccountRecord row(size_t slot) const {
+        AccountRecord r;
+        r.balance = __atomic_load_n(&balances[slot], __ATOMIC_RELAXED);
+        r.accNumber = accNumbers[slot];
+        r.currency = currencies[slot];
+        r.product = __atomic_load_n(&products[slot], __ATOMIC_RELAXED);
+        return r;
+    }
+
+    int accNumber(size_t slot) const { return accNumbers[slot]; }
+    string_view name(size_t slot) const { return names->get(nameIds[slot]); }
+    Currency currency(size_t slot) const { return (Currency)currencies[slot]; }
+    Money balance(size_t slot) const {
+        return Money::fromMinor(__atomic_load_n(&balances[slot], __ATOMIC_RELAXED), currency(slot));
+    }
+    // Writable balance; the slot counts as changed from here on
+    int64_t& balanceMinor(size_t slot) {
+        dirty[slot] = 1;
+        return balances[slot];
+    }
+    const int64_t* balanceColumn() const { return balances.data(); }
+    const uint16_t* productColumn() const { return products.data(); }
+    uint16_t product(size_t slot) const { return products[slot]; }
+    void setProduct(size_t slot, uint16_t code) {
+        if (products[slot] != code) dirty[slot] = 1;
+        products[slot] = code;
+    }
+
+    // balances[i] += delta[i] for every slot; changed slots become dirty
+    void addToBalances(const int64_t* delta) {
+        for (size_t i = 0; i < balances.size(); ++i) {
+            balances[i] += delta[i];
+            dirty[i] |= delta[i] != 0;
+        }
+    }
+
+    // Slots whose balance or currency changed since the last markClean()
+    void dirtySlots(vector<uint32_t>& out) const {
+        out.clear();
+        const uint8_t* d = dirty.data();
+        const uint8_t* end = d + dirty.size();
+        for (const uint8_t* p = d; p < end; ++p) {
+            p = static_cast<const uint8_t*>(memchr(p, 1, (size_t)(end - p)));
+            if (!p) break;
+            out.push_back((uint32_t)(p - d));
+        }
+    }
+    // Rows were added, renamed or dropped since the last markClean()
+    bool layoutChanged() const { return reshaped; }
+    void markClean() {
+        fill(dirty.begin(), dirty.end(), 0);
+        reshaped = false;
+    }
+
+    BankAccount materialize(size_t slot) const { return BankAccount(row(slot), name(slot)); }
+
+    // Copy every column into out; names are shared, not copied
+    void snapshotTo(AccountSnapshot& out) const {
+        out.accNumbers = accNumbers;
+        out.balances = balances;
+        out.currencies = currencies;
+        out.products = products;
+        out.nameIds = nameIds;
+        out.nameById.resize(names->size());
+        for (uint32_t id = 0; id < names->size(); ++id) out.nameById[id] = names->get(id);
+        out.pool = names;
+    }
+};
+
+// Scan kernels over a balance column. With AVX2 enabled (-mavx2 or
+// -march=native) they process four balances per instruction; otherwise the
+// plain loops are left to the compiler's auto-vectoriser.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+
+// Sum of n balances (the caller keeps totals within int64)
+inline int64_t sum(const int64_t* v, size_t n) {
+    size_t i = 0;
+    int64_t total = 0;
+#if defined(__AVX2__)
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i*)(v + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i*)(v + i + 4)));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) total += v[i];
+    return total;
+}
+
+// Smallest / largest of n > 0 balances
+inline int64_t minimum(const int64_t* v, size_t n) {
+    size_t i = 0;
+    int64_t best = numeric_limits<int64_t>::max();
+#if defined(__AVX2__)
+    __m256i m = _mm256_set1_epi64x(best);
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+        m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256((__m256i*)lanes, m);
+    for (int64_t x : lanes) best = x < best ? x : best;
+#endif
+    for (; i < n; ++i) best = v[i] < best ? v[i] : best;
+    return best;
+}
+
+inline int64_t maximum(const int64_t* v, size_t n) {
+    size_t i = 0;
+    int64_t best = numeric_limits<int64_t>::min();
+#if defined(__AVX2__)
+    __m256i m = _mm256_set1_epi64x(best);
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+        m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256((__m256i*)lanes, m);
+    for (int64_t x : lanes) best = x > best ? x : best;
+#endif
+    for (; i < n; ++i) best = v[i] > best ? v[i] : best;
+    return best;
+}
+
+// Append the index of every balance below threshold to out
+inline void filterBelow(const int64_t* v, size_t n, int64_t threshold, vector<uint32_t>& out) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i t = _mm256_set1_epi64x(threshold);
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, x)));
+        while (mask) {
+            out.push_back((uint32_t)(i + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; ++i)
+        if (v[i] < threshold) out.push_back((uint32_t)i);
+}
+
+// Interest on n balances at per-product rates:
+//   interest[i] = round(v[i] * factors[min(products[i], lastProduct)])
+// for positive balances and 0 for the rest, rounded to the nearest minor unit
+// (ties to even). The AVX2 path converts through double with the 2^52 + 2^51
+// trick, which is exact below 2^51 minor units; a block holding a larger
+// balance takes the scalar path, which gives the same result.
+inline void accrue(const int64_t* v, const uint16_t* products, const double* factors, uint32_t lastProduct,
+                   size_t n, int64_t* interest) {
+    auto one = [&](size_t i) {
+        double t = (double)v[i] * factors[min<uint32_t>(products[i], lastProduct)];
+        interest[i] = v[i] > 0 ? (int64_t)nearbyint(t) : 0;
+    };
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256d magicD = _mm256_set1_pd(6755399441055744.0);           // 2^52 + 2^51
+    const __m256i magicI = _mm256_castpd_si256(magicD);
+    const __m256i exactLimit = _mm256_set1_epi64x((int64_t(1) << 51) - 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i last = _mm_set1_epi32((int)lastProduct);
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+        if (!_mm256_testz_si256(_mm256_cmpgt_epi64(x, exactLimit), _mm256_cmpgt_epi64(x, exactLimit))) {
+            for (size_t k = i; k < i + 4; ++k) one(k);
+            continue;
+        }
+        __m128i idx = _mm_min_epu32(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(products + i))), last);
+        __m256d f = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), factors, idx,
+                                             _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+        __m256i positive = _mm256_cmpgt_epi64(x, zero);
+        // non-positive lanes are zeroed first so the conversion below stays in range
+        __m256d xd = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(_mm256_and_si256(x, positive), magicI)),
+                                   magicD);
+        __m256d r = _mm256_round_pd(_mm256_mul_pd(xd, f), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256i q = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(r, magicD)), magicI);
+        _mm256_storeu_si256((__m256i*)(interest + i), _mm256_and_si256(q, positive));
+    }
+#endif
+    for (; i < n; ++i) one(i);
+}
+
+} // namespace kernels
+
+// --------------------------- 5b) WRITE-AHEAD LOG ---------------------------------
+// transactions.txt is an append-only log and the source of truth for balance
+// changes; accounts.txt is a snapshot of the state at some log offset.
+// Appenders queue their record and get the log offset it ends at as a ticket.
+// A committer thread gathers everything queued within the commit window into
+// one write (plus one fsync in Durable mode), so concurrent commits share the
+// cost of a single flush. The log file stays open for the log's lifetime and
+// records go through two buffers that swap roles batch by batch, so steady
+// traffic allocates nothing; a batch that reaches the buffer size is written
+// at once instead of waiting out the window.
+enum class Durability {
+    Durable,   // transferFunds returns once its record is fsynced
+    Buffered   // records are written in the background; fsync only on flush()
+};
+
+// fsync the directory holding path, so a file created or renamed there survives a crash
+static bool syncParentDir(const string& path) {
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// Replace a file so readers see either the old or the new contents, never a
+// mix; once this returns the new contents survive a crash
+static void writeFileAtomically(const string& path, const string& contents) {
+    string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw runtime_error("Unable to open " + tmp + " for writing.");
+    bool ok = writeAll(fd, contents.data(), contents.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        throw runtime_error("Unable to write " + path + ".");
+    }
+    if (!syncParentDir(path)) throw runtime_error("Unable to sync the directory of " + path + ".");
+}
+
+class WriteAheadLog {
+private:
+    int fd = -1;
+    const Durability mode;
+    const chrono::microseconds window;
+    mutex m;
+    condition_variable wake;      // committer: work arrived or shutdown
+    condition_variable done;      // appenders: a batch reached the file
+    const size_t bufferSize;
+    string pending;               // records queued for the next batch
+    string inflight;              // the batch being written
+    uint64_t appendedEnd = 0;     // log position after the last queued record
+    uint64_t syncedEnd = 0;       // log position known to be fsynced
+    uint64_t fileBase = 0;        // log position of the current file's first byte
+    bool flushRequested = false;
+    bool writing = false;         // the committer is using fd
+    bool stopping = false;
+    bool failed = false;
+    struct DurableCallback {
+        uint64_t ticket;
+        function<void(bool)> done;
+    };
+    vector<DurableCallback> callbacks;   // whenDurable calls still waiting for their batch
+    thread committer;
+
+    // Run the callbacks whose records are now durable (or never will be); lk is released meanwhile
+    void runCallbacks(unique_lock<mutex>& lk) {
+        vector<DurableCallback> ready;
+        auto waiting = partition(callbacks.begin(), callbacks.end(),
+                                 [this](const DurableCallback& c) { return !failed && c.ticket > syncedEnd; });
+        move(waiting, callbacks.end(), back_inserter(ready));
+        callbacks.erase(waiting, callbacks.end());
+        bool ok = !failed;
+        lk.unlock();
+        for (auto& c : ready) c.done(ok);
+        lk.lock();
+    }
+
+    void run() {
+        unique_lock<mutex> lk(m);
+        for (;;) {
+            wake.wait(lk, [this] { return stopping || flushRequested || !pending.empty(); });
+            if (stopping && pending.empty() && !flushRequested) break;
+            // let more commits join this batch unless someone is waiting on a flush
+            if (!stopping && !flushRequested && window.count() > 0 && pending.size() < bufferSize)
+                wake.wait_for(lk, window,
+                              [this] { return stopping || flushRequested || pending.size() >= bufferSize; });
+
+            inflight.clear();
+            inflight.swap(pending);       // pending takes over the last batch's capacity
+            uint64_t end = appendedEnd;
+            bool sync = mode == Durability::Durable || flushRequested || stopping;
+            flushRequested = false;
+            writing = true;
+            lk.unlock();
+            bool ok = writeAll(fd, inflight.data(), inflight.size()) && (!sync || ::fdatasync(fd) == 0);
+            if (inflight.capacity() > 4 * bufferSize) {   // do not hold on to a one-off burst
+                string().swap(inflight);
+                inflight.reserve(bufferSize);
+            }
+            lk.lock();
+            writing = false;
+            if (!ok) failed = true;
+            else if (sync) syncedEnd = end;
+            done.notify_all();
+            if (!callbacks.empty()) runCallbacks(lk);
+        }
+    }
+
+public:
+    static constexpr size_t defaultBufferSize = 256 * 1024;
+
+    WriteAheadLog(const string& path, Durability mode, chrono::microseconds window,
+                  size_t bufferSize = defaultBufferSize)
+        : mode(mode), window(window), bufferSize(max<size_t>(bufferSize, 4096)) {
+        pending.reserve(this->bufferSize);
+        inflight.reserve(this->bufferSize);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw runtime_error("Unable to open transaction log " + path + ".");
+        if (!syncParentDir(path)) {              // the log may have just been created
+            ::close(fd);
+            throw runtime_error("Unable to sync the directory of " + path + ".");
+        }
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        appendedEnd = syncedEnd = end < 0 ? 0 : (uint64_t)end;
+        committer = thread(&WriteAheadLog::run, this);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        wake.notify_one();
+        committer.join();
+        ::close(fd);
+    }
+
+    // Queue one record; returns the log position it ends at, its ticket for
+    // waitDurable. Positions count from the first file's start and keep
+    // growing across seal(); appended() and flush() are offsets in the
+    // current file.
+    uint64_t append(string_view record) {
+        lock_guard<mutex> lk(m);
+        if (failed) throw runtime_error("Unable to write transaction file.");
+        bool wasIdle = pending.empty();
+        bool wasBelow = pending.size() < bufferSize;
+        pending += record;
+        appendedEnd += record.size();
+        if (wasIdle || (wasBelow && pending.size() >= bufferSize)) wake.notify_one();
+        return appendedEnd;
+    }
+
+    // Log offset after the last queued record, durable or not
+    uint64_t appended() {
+        lock_guard<mutex> lk(m);
+        return appendedEnd - fileBase;
+    }
+
+    // Block until the record behind ticket is durable (no-op in Buffered mode)
+    void waitDurable(uint64_t ticket) {
+        if (mode == Durability::Buffered) return;
+        unique_lock<mutex> lk(m);
+        done.wait(lk, [&] { return failed || syncedEnd >= ticket; });
+        if (syncedEnd < ticket) throw runtime_error("Unable to write transaction file.");
+    }
+
+    // Call done(true) once the record behind ticket is durable, or done(false)
+    // if the log fails first -- right away on this thread when that is known
+    // already (always in Buffered mode), otherwise on the committer thread,
+    // so done must be quick: hand the work to another thread.
+    void whenDurable(uint64_t ticket, function<void(bool)> done) {
+        bool ok = true;                     // as waitDurable: Buffered mode never waits
+        if (mode == Durability::Durable) {
+            lock_guard<mutex> lk(m);
+            if (!failed && syncedEnd < ticket) {
+                callbacks.push_back({ticket, std::move(done)});
+                return;
+            }
+            ok = syncedEnd >= ticket;
+        }
+        done(ok);
+    }
+
+    // Write and fsync everything queued so far; returns the durable log offset
+    uint64_t flush() {
+        unique_lock<mutex> lk(m);
+        uint64_t target = appendedEnd;
+        flushRequested = true;
+        wake.notify_one();
+        done.wait(lk, [&] { return failed || syncedEnd >= target; });
+        if (syncedEnd < target) throw runtime_error("Unable to write transaction file.");
+        return target - fileBase;
+    }
+
+    // Take no more records: the caller could not record what the log now holds
+    void fail() {
+        lock_guard<mutex> lk(m);
+        failed = true;
+        done.notify_all();
+    }
+
+    // Make everything queued durable, move the log file from path to
+    // sealedPath and continue in a new, empty file at path. Tickets issued
+    // before stay valid. The caller keeps appends out until this returns.
+    void seal(const string& path, const string& sealedPath) {
+        unique_lock<mutex> lk(m);
+        auto settled = [this] { return failed || (!writing && pending.empty() && syncedEnd >= appendedEnd); };
+        if (!settled()) {
+            flushRequested = true;
+            wake.notify_one();
+            done.wait(lk, settled);
+        }
+        if (failed) throw runtime_error("Unable to write transaction file.");
+        if (::rename(path.c_str(), sealedPath.c_str()) != 0) throw runtime_error("Unable to seal transaction log " + path + ".");
+        int next = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (next < 0) {
+            ::rename(sealedPath.c_str(), path.c_str());
+            throw runtime_error("Unable to open transaction log " + path + ".");
+        }
+        ::close(fd);
+        fd = next;
+        fileBase = appendedEnd;
+        if (!syncParentDir(path)) {
+            failed = true;                      // the switch may not survive a crash: take no more records
+            throw runtime_error("Unable to sync the directory of " + path + ".");
+        }
+    }
+};
+
+// --------------------------- 5c) BINARY ACCOUNT FILE -----------------------------
+// Versioned snapshot format (accounts.dat), native byte order:
+//   header | AccountRecord[count] | NameRef[count] | name heap
+// Records are fixed width and are exactly the in-memory AccountRecord; the
+// name offset table points into the heap. The file is read by mapping it and
+// walking the record array, with no parsing. Any other version is rejected;
+// the legacy text accounts.txt is converted on first use instead (5c loaders).
+static const char accountFileMagic[8] = {'B', 'A', 'N', 'K', 'A', 'C', 'C', '\0'};
+static const uint32_t accountFileVersion = 4;
+
+struct AccountFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;         // sizeof(AccountRecord) of the writer
+    uint64_t count;
+    uint64_t walOffset;          // log offset this snapshot is consistent with
+    uint64_t logSegment;         // sealed log segments before the log walOffset is in
+    uint64_t namesOffset;        // file offset of the name heap
+};
+
+struct NameRef {
+    uint32_t offset;             // relative to the name heap
+    uint32_t length;
+};
+
+static_assert(sizeof(AccountFileHeader) == 48, "account file header layout changed");
+static_assert(sizeof(NameRef) == 8, "name offset table layout changed");
+
+static uint64_t fileSize(const string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+static bool fileExists(const string& path) {
+    return ::access(path.c_str(), F_OK) == 0;
+}
+
+// Read-only private mapping of a whole file
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t len = 0;
+public:
+    explicit MappedFile(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Unable to open " + path + " for reading.");
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw runtime_error("Unable to stat " + path + ".");
+        }
+        len = (size_t)st.st_size;
+        if (len > 0) {
+            void* p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw runtime_error("Unable to map " + path + ".");
+            }
+            ::madvise(p, len, MADV_SEQUENTIAL);
+            base = static_cast<const char*>(p);
+        }
+        ::close(fd);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { if (base) ::munmap(const_cast<char*>(base), len); }
+
+    const char* data() const { return base; }
+    size_t size() const { return len; }
+};
+
+static string encodeAccountFile(const AccountTable& table, uint64_t walOffset, uint64_t logSegment = 0) {
+    size_t n = table.size();
+    size_t namesBytes = 0;
+    for (size_t i = 0; i < n; ++i) namesBytes += table.name(i).size();
+    if (namesBytes > numeric_limits<uint32_t>::max()) throw runtime_error("Account names exceed the 4 GiB name heap.");
+
+    AccountFileHeader h;
+    memcpy(h.magic, accountFileMagic, sizeof h.magic);
+    h.version = accountFileVersion;
+    h.recordSize = sizeof(AccountRecord);
+    h.count = n;
+    h.walOffset = walOffset;
+    h.logSegment = logSegment;
+    h.namesOffset = sizeof h + n * (sizeof(AccountRecord) + sizeof(NameRef));
+
+    string out(h.namesOffset + namesBytes, '\0');
+    memcpy(&out[0], &h, sizeof h);
+    char* recs = &out[sizeof h];
+    char* refs = recs + n * sizeof(AccountRecord);
+    char* heap = &out[h.namesOffset];
+    uint32_t nameOff = 0;
+    for (size_t i = 0; i < n; ++i) {
+        AccountRecord r = table.row(i);
+        string_view name = table.name(i);
+        NameRef ref = {nameOff, (uint32_t)name.size()};
+        memcpy(recs + i * sizeof r, &r, sizeof r);
+        memcpy(refs + i * sizeof ref, &ref, sizeof ref);
+        memcpy(heap + nameOff, name.data(), name.size());
+        nameOff += ref.length;
+    }
+    return out;
+}
+
+// Walk a mapped account file, calling onAccount(record, name) per account;
+// returns the log offset the snapshot covers
+template<typename F>
+uint64_t decodeAccountFile(const MappedFile& file, F&& onAccount) {
+    AccountFileHeader h;
+    if (file.size() < sizeof h) throw runtime_error("Account file is truncated.");
+    memcpy(&h, file.data(), sizeof h);
+    if (memcmp(h.magic, accountFileMagic, sizeof h.magic) != 0 || h.version != accountFileVersion ||
+        h.recordSize != sizeof(AccountRecord))
+        throw runtime_error("Unsupported account file format.");
+    uint64_t perAccount = sizeof(AccountRecord) + sizeof(NameRef);
+    if (h.count > (file.size() - sizeof h) / perAccount
+        || h.namesOffset < sizeof h + h.count * perAccount || h.namesOffset > file.size())
+        throw runtime_error("Account file is truncated.");
+
+    const char* names = file.data() + h.namesOffset;
+    uint64_t namesBytes = file.size() - h.namesOffset;
+    auto name = [&](uint64_t off, uint32_t len) {
+        if (off > namesBytes || len > namesBytes - off)
+            throw runtime_error("Account file has a bad name offset.");
+        return string_view(names + off, len);
+    };
+    const char* recs = file.data() + sizeof h;
+    const AccountRecord* rows = reinterpret_cast<const AccountRecord*>(recs);
+    const NameRef* refs = reinterpret_cast<const NameRef*>(recs + h.count * sizeof(AccountRecord));
+    for (uint64_t i = 0; i < h.count; ++i) onAccount(rows[i], name(refs[i].offset, refs[i].length));
+    return h.walOffset;
+}
+
+// In-place checkpoints. When only balances changed, the changed records are
+// written over their own rows of accounts.dat (row i is table slot i)
+// instead of rewriting the whole file. The patch is first made durable in a
+// side journal next to the file; overwriting starts only after that, so a
+// crash midway is repaired on the next open by applying the journal again,
+// and a torn journal means the file was never touched and is discarded.
+static const char accountJournalMagic[8] = {'B', 'A', 'N', 'K', 'J', 'N', 'L', '\0'};
+
+struct AccountJournalHeader {
+    char magic[8];
+    uint64_t count;              // entries that follow
+    uint64_t walOffset;          // new walOffset and logSegment of the patched file
+    uint64_t logSegment;
+};
+
+struct AccountJournalEntry {
+    uint64_t slot;
+    AccountRecord record;
+};
+// ...followed by a uint64 FNV-1a checksum of everything before it
+
+static string accountJournalPath(const string& path) { return path + ".journal"; }
+
+static uint64_t fnv1a(const char* p, size_t n) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)p[i]) * 1099511628211ull;
+    return h;
+}
+
+// pwrite() the whole buffer at off, retrying on short writes and EINTR
+static bool pwriteAll(int fd, const void* data, size_t len, uint64_t off) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd, p, len, (off_t)off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        off += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Apply an encoded journal to the file at path; false if the journal is torn.
+// Runs of adjacent slots go out as one write.
+static bool applyAccountJournal(const string& path, const string& journal) {
+    AccountJournalHeader jh;
+    uint64_t sum;
+    if (journal.size() < sizeof jh + sizeof sum) return false;
+    memcpy(&jh, journal.data(), sizeof jh);
+    if (memcmp(jh.magic, accountJournalMagic, sizeof jh.magic) != 0) return false;
+    if (jh.count > (journal.size() - sizeof jh - sizeof sum) / sizeof(AccountJournalEntry)) return false;
+    size_t body = sizeof jh + jh.count * sizeof(AccountJournalEntry);
+    if (journal.size() != body + sizeof sum) return false;
+    memcpy(&sum, journal.data() + body, sizeof sum);
+    if (sum != fnv1a(journal.data(), body)) return false;
+
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) throw runtime_error("Unable to open " + path + " for writing.");
+    AccountFileHeader h;
+    bool ok = ::pread(fd, &h, sizeof h, 0) == (ssize_t)sizeof h;
+    if (ok && (memcmp(h.magic, accountFileMagic, sizeof h.magic) != 0 || h.version != accountFileVersion)) {
+        ::close(fd);
+        throw runtime_error("Account journal does not match " + path + ".");
+    }
+    vector<AccountRecord> run;
+    uint64_t runStart = 0;
+    auto writeRun = [&] {
+        ok = ok && (run.empty() || pwriteAll(fd, run.data(), run.size() * sizeof(AccountRecord),
+                                             sizeof h + runStart * sizeof(AccountRecord)));
+        run.clear();
+    };
+    for (uint64_t i = 0; ok && i < jh.count; ++i) {
+        AccountJournalEntry e;
+        memcpy(&e, journal.data() + sizeof jh + i * sizeof e, sizeof e);
+        if (e.slot >= h.count) {
+            ::close(fd);
+            throw runtime_error("Account journal does not match " + path + ".");
+        }
+        if (run.empty() || e.slot != runStart + run.size()) {
+            writeRun();
+            runStart = e.slot;
+        }
+        run.push_back(e.record);
+    }
+    writeRun();
+    static_assert(offsetof(AccountFileHeader, logSegment) == offsetof(AccountFileHeader, walOffset) + 8 &&
+                  offsetof(AccountJournalHeader, logSegment) == offsetof(AccountJournalHeader, walOffset) + 8,
+                  "walOffset and logSegment are written together");
+    ok = ok && pwriteAll(fd, &jh.walOffset, 2 * sizeof(uint64_t), offsetof(AccountFileHeader, walOffset))
+            && ::fdatasync(fd) == 0;
+    ::close(fd);
+    if (!ok) throw runtime_error("Unable to update " + path + ".");
+    return true;
+}
+
+// Finish (or discard, if torn) an in-place checkpoint interrupted by a crash
+static void recoverAccountFile(const string& path) {
+    string jpath = accountJournalPath(path);
+    if (!fileExists(jpath)) return;
+    string journal;
+    {
+        ifstream ifs(jpath, ios::binary);
+        journal.assign(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+    }
+    if (fileExists(path)) applyAccountJournal(path, journal);
+    ::unlink(jpath.c_str());
+}
+
+// Checkpoint the given slots of table into the account file at path in place
+static void patchAccountFile(const string& path, const AccountTable& table, const vector<uint32_t>& slots,
+                             uint64_t walOffset, uint64_t logSegment) {
+    AccountJournalHeader jh;
+    memcpy(jh.magic, accountJournalMagic, sizeof jh.magic);
+    jh.count = slots.size();
+    jh.walOffset = walOffset;
+    jh.logSegment = logSegment;
+    size_t body = sizeof jh + slots.size() * sizeof(AccountJournalEntry);
+    string journal(body + sizeof(uint64_t), '\0');
+    memcpy(&journal[0], &jh, sizeof jh);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        AccountJournalEntry e = {slots[i], table.row(slots[i])};
+        memcpy(&journal[sizeof jh + i * sizeof e], &e, sizeof e);
+    }
+    uint64_t sum = fnv1a(journal.data(), body);
+    memcpy(&journal[body], &sum, sizeof sum);
+
+    string jpath = accountJournalPath(path);
+    int fd = ::open(jpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw runtime_error("Unable to open " + jpath + " for writing.");
+    bool ok = writeAll(fd, journal.data(), journal.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || !syncParentDir(jpath)) {         // the journal must be found again after a crash
+        ::unlink(jpath.c_str());
+        throw runtime_error("Unable to write " + jpath + ".");
+    }
+    applyAccountJournal(path, journal);
+    ::unlink(jpath.c_str());
+}
+
+// What a load found. Malformed lines are skipped rather than failing the
+// load, and counted here so the caller can tell a clean file from a damaged one.
+struct LoadStats {
+    size_t accountsLoaded = 0;        // account records applied (later ones supersede)
+    size_t accountLinesSkipped = 0;   // malformed lines in a legacy accounts file
+    size_t logRecordsApplied = 0;     // transaction log records replayed
+    size_t logLinesSkipped = 0;       // malformed lines in the transaction log
+};
+
+static size_t countLines(const char* p, const char* end) {
+    size_t lines = 0;
+    for (; p < end; ++lines) {
+        const void* nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+    return lines;
+}
+
+// Parse the name|acc|balance lines in [p, end), calling onAccount for each
+// well-formed one; returns the number of malformed lines. Only the first line
+// of the file (fileStart) may be a "#checkpoint|<offset>" line, stored in covered.
+template<typename F>
+static size_t parseAccountText(const char* p, const char* end, bool fileStart, uint64_t& covered, F&& onAccount) {
+    static const string_view checkpointTag = "#checkpoint|";
+    size_t skipped = 0;
+    bool first = fileStart;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', (size_t)(end - p)));
+        string_view line(p, (size_t)((nl ? nl : end) - p));
+        p = nl ? nl + 1 : end;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+        string_view name;
+        int acc;
+        Money bal;
+        if (first && line.substr(0, checkpointTag.size()) == checkpointTag) {
+            string_view off = line.substr(checkpointTag.size());
+            auto r = from_chars(off.data(), off.data() + off.size(), covered);
+            if (r.ec != errc()) ++skipped;
+        } else if (BankAccount::tryParseRecord(line, name, acc, bal)) {
+            onAccount(AccountRecord::make(acc, bal), name);
+        } else {
+            ++skipped; // malformed line
+        }
+        first = false;
+    }
+    return skipped;
+}
+
+// Below this size a file is parsed on the calling thread
+constexpr size_t minParallelLoadChunk = size_t(1) << 20;
+
+// Bulk-load a legacy name|acc|balance text file into table (later records
+// supersede earlier ones). The file is mapped and parsed in place with
+// string_view/from_chars, so the parse makes no per-record heap allocation.
+// Large files are cut at line boundaries into up to `threads` chunks (0: one
+// per hardware thread) that are parsed on a thread pool into per-chunk row
+// buffers whose names still point into the mapping; the buffers are then
+// merged into the table in file order, so the outcome matches a sequential
+// load. Text files may start with a "#checkpoint|<offset>" line, which is
+// stored in covered.
+static LoadStats loadLegacyAccountText(const string& textPath, AccountTable& table, uint64_t& covered,
+                                       unsigned threads = 1) {
+    MappedFile file(textPath);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    size_t chunks = min<size_t>(threads, file.size() / minParallelLoadChunk + 1);
+
+    LoadStats stats;
+    if (chunks <= 1) {
+        size_t lines = countLines(begin, end);
+        table.reserve(table.size() + lines);
+        table.reserveNames(table.size() + lines);
+        stats.accountLinesSkipped = parseAccountText(begin, end, true, covered,
+            [&](const AccountRecord& r, string_view name) {
+                table.upsert(r, name);
+                ++stats.accountsLoaded;
+            });
+        return stats;
+    }
+
+    // Chunk i is [cuts[i], cuts[i + 1]); every cut is the start of a line
+    vector<const char*> cuts(chunks + 1, end);
+    cuts[0] = begin;
+    for (size_t i = 1; i < chunks; ++i) {
+        const char* c = max(begin + file.size() / chunks * i, cuts[i - 1]);
+        const void* nl = memchr(c, '\n', (size_t)(end - c));
+        cuts[i] = nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+
+    struct Chunk {
+        vector<pair<AccountRecord, string_view>> rows;
+        size_t skipped = 0;
+    };
+    vector<Chunk> parsed(chunks);
+    {
+        ThreadPool pool((unsigned)chunks);
+        vector<future<void>> done;
+        done.reserve(chunks);
+        for (size_t i = 0; i < chunks; ++i) {
+            done.push_back(pool.submit([&, i] {
+                Chunk& c = parsed[i];
+                c.rows.reserve(countLines(cuts[i], cuts[i + 1]));
+                // only chunk 0 holds the checkpoint line, so only it writes covered
+                c.skipped = parseAccountText(cuts[i], cuts[i + 1], i == 0, covered,
+                    [&c](const AccountRecord& r, string_view name) { c.rows.emplace_back(r, name); });
+            }));
+        }
+        for (auto& d : done) d.get();
+    }
+
+    size_t rows = 0;
+    for (const auto& c : parsed) rows += c.rows.size();
+    table.reserve(table.size() + rows);
+    table.reserveNames(table.size() + rows);
+    for (const auto& c : parsed) {
+        for (const auto& r : c.rows) table.upsert(r.first, r.second);
+        stats.accountsLoaded += c.rows.size();
+        stats.accountLinesSkipped += c.skipped;
+    }
+    return stats;
+}
+
+// Convert a legacy name|acc|balance text file into the binary format. Files
+// without a checkpoint line predate the transaction log and were rewritten
+// after every transfer, so they cover the whole log at logPath.
+static LoadStats convertLegacyAccountFile(const string& textPath, const string& binPath, const string& logPath,
+                                          unsigned threads = 1) {
+    uint64_t covered = fileSize(logPath);
+    AccountTable table;
+    LoadStats stats = loadLegacyAccountText(textPath, table, covered, threads);
+    writeFileAtomically(binPath, encodeAccountFile(table, covered));
+    return stats;
+}
+
+// --------------------------- 5d) LOCK STRIPES -----------------------------------
+// Per-account locking without a mutex per account: account numbers hash onto a
+// fixed set of cache-line-sized stripes. Operations on two accounts lock their
+// stripes in ascending stripe order -- the same order for every thread, hence
+// no deadlocks (ordering by account number would not be enough once two
+// accounts share a stripe). Structural changes to the store lock every stripe.
+// Reads need no mutex: every stripe is also a seqlock. PairLock and
+// StripeSetLock make a stripe's version odd while they hold it, and read()
+// retries until it saw one even version throughout. Structural changes move
+// memory a reader may be looking at, so AllStripesLock also waits for the
+// readers counted on each stripe to leave, and new readers queue on the mutex.
+class LockStripes {
+private:
+    struct alignas(64) Stripe {
+        mutex m;
+        atomic<uint32_t> version{0};      // odd while a writer holds m
+        atomic<uint32_t> readers{0};      // optimistic readers inside read()
+    };
+    unique_ptr<Stripe[]> stripes;
+    atomic<bool> restructuring{false};
+
+    friend class PairLock;
+    friend class StripeSetLock;
+    friend class AllStripesLock;
+
+    // Writers call these while holding the stripe's mutex
+    void beginWrite(size_t i) {
+        Stripe& s = stripes[i];
+        s.version.store(s.version.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+    void endWrite(size_t i) {
+        Stripe& s = stripes[i];
+        s.version.store(s.version.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+public:
+    static constexpr unsigned stripeBits = 10;
+    static constexpr size_t count = size_t(1) << stripeBits;
+
+    LockStripes() : stripes(new Stripe[count]) {}
+
+    static size_t stripeOf(int accNumber) {
+        return ((uint32_t)accNumber * 2654435761u) >> (32 - stripeBits);   // Fibonacci hashing
+    }
+
+    mutex& at(size_t i) { return stripes[i].m; }
+
+    // Run f, which reads only state guarded by accNumber's stripe, without
+    // locking it. f may run several times and see torn values on the runs
+    // that are discarded, so it must only copy what it reads. then() runs
+    // once, after the run whose result is returned, while the layout still
+    // cannot change: side effects of the read (cache bookkeeping) go there.
+    template<typename F, typename Then>
+    auto read(int accNumber, F&& f, Then&& then) -> decltype(f()) {
+        Stripe& s = stripes[stripeOf(accNumber)];
+        s.readers.fetch_add(1, memory_order_seq_cst);
+        if (restructuring.load(memory_order_seq_cst)) {
+            s.readers.fetch_sub(1, memory_order_release);
+            lock_guard<mutex> lk(s.m);                  // wait the restructuring out
+            auto result = f();
+            then();
+            return result;
+        }
+        for (unsigned spins = 0;; ++spins) {
+            uint32_t v = s.version.load(memory_order_acquire);
+            if (v & 1) {
+                if (spins > 64) this_thread::yield();
+                continue;
+            }
+            auto result = f();
+            atomic_thread_fence(memory_order_acquire);
+            if (s.version.load(memory_order_relaxed) == v) {
+                then();
+                s.readers.fetch_sub(1, memory_order_release);
+                return result;
+            }
+        }
+    }
+
+    template<typename F>
+    auto read(int accNumber, F&& f) -> decltype(f()) {
+        return read(accNumber, std::forward<F>(f), [] {});
+    }
+};
+
+// Holds the stripes of a pair of accounts (one stripe if they share it)
+class PairLock {
+private:
+    LockStripes& s;
+    size_t lo, hi;
+public:
+    PairLock(LockStripes& stripes, int accA, int accB)
+        : s(stripes), lo(LockStripes::stripeOf(accA)), hi(LockStripes::stripeOf(accB)) {
+        if (lo > hi) swap(lo, hi);
+        s.at(lo).lock();
+        if (hi != lo) s.at(hi).lock();
+        s.beginWrite(lo);
+        if (hi != lo) s.beginWrite(hi);
+    }
+    PairLock(const PairLock&) = delete;
+    PairLock& operator=(const PairLock&) = delete;
+    ~PairLock() {
+        if (hi != lo) s.endWrite(hi);
+        s.endWrite(lo);
+        if (hi != lo) s.at(hi).unlock();
+        s.at(lo).unlock();
+    }
+};
+
+// Holds an arbitrary set of stripes, locked in ascending order
+class StripeSetLock {
+private:
+    LockStripes& s;
+    vector<size_t> held;
+public:
+    StripeSetLock(LockStripes& stripes, vector<size_t> ids) : s(stripes), held(std::move(ids)) {
+        sort(held.begin(), held.end());
+        held.erase(unique(held.begin(), held.end()), held.end());
+        for (size_t i : held) s.at(i).lock();
+        for (size_t i : held) s.beginWrite(i);
+    }
+    StripeSetLock(const StripeSetLock&) = delete;
+    StripeSetLock& operator=(const StripeSetLock&) = delete;
+    ~StripeSetLock() {
+        for (size_t i : held) s.endWrite(i);
+        for (size_t i = held.size(); i-- > 0;) s.at(held[i]).unlock();
+    }
+};
+
+// Holds every stripe: excludes all transfers and reads while the store is restructured
+class AllStripesLock {
+private:
+    LockStripes& s;
+public:
+    explicit AllStripesLock(LockStripes& stripes) : s(stripes) {
+        for (size_t i = 0; i < LockStripes::count; ++i) s.at(i).lock();
+        s.restructuring.store(true, memory_order_seq_cst);
+        for (size_t i = 0; i < LockStripes::count; ++i) {
+            while (s.stripes[i].readers.load(memory_order_seq_cst) != 0) this_thread::yield();
+        }
+    }
+    AllStripesLock(const AllStripesLock&) = delete;
+    AllStripesLock& operator=(const AllStripesLock&) = delete;
+    ~AllStripesLock() {
+        s.restructuring.store(false, memory_order_release);
+        for (size_t i = LockStripes::count; i-- > 0;) s.at(i).unlock();
+    }
+};
+
+// One row of a batch transfer
+struct TransferRequest {
+    int fromAcc;
+    int toAcc;
+    Money amount;
+};
+
+// --------------------------- 5e) TRANSACTION HISTORY -----------------------------
+// Reading the log back. TransactionLogReader streams records through one fixed
+// buffer, so memory stays constant however long the log is (a line longer
+// than the buffer widens it). Only complete, newline-terminated lines are
+// returned; position() tells where the last one ended, so a torn tail shows
+// up as position() < file size.
+class TransactionLogReader {
+private:
+    int fd = -1;
+    bool ownsFd = true;
+    vector<char> buf;
+    size_t head = 0;               // unread bytes are buf[head, tail)
+    size_t tail = 0;
+    uint64_t bufOffset;            // log offset of buf[0]
+    uint64_t limit;                // nothing at or past this offset is read
+    bool eof = false;
+    size_t malformed = 0;
+
+    // Read more of the log behind the unread bytes; false at the end
+    bool fill() {
+        if (eof) return false;
+        if (head > 0) {
+            memmove(buf.data(), buf.data() + head, tail - head);
+            bufOffset += head;
+            tail -= head;
+            head = 0;
+        }
+        if (tail == buf.size()) buf.resize(buf.size() * 2);
+        uint64_t at = bufOffset + tail;
+        size_t want = at >= limit ? 0 : (size_t)min<uint64_t>(buf.size() - tail, limit - at);
+        ssize_t n = 0;
+        if (want > 0) {
+            do n = ::pread(fd, buf.data() + tail, want, (off_t)at); while (n < 0 && errno == EINTR);
+            if (n < 0) throw runtime_error("Unable to read transaction file.");
+        }
+        if (n == 0) eof = true;
+        tail += (size_t)n;
+        return n > 0;
+    }
+
+public:
+    static constexpr size_t defaultBufferSize = 64 * 1024;
+
+    explicit TransactionLogReader(const string& path, uint64_t from = 0,
+                                  uint64_t to = numeric_limits<uint64_t>::max(),
+                                  size_t bufferSize = defaultBufferSize)
+        : buf(max<size_t>(bufferSize, 256)), bufOffset(from), limit(to) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Unable to open transaction log " + path + ".");
+    }
+    // Read through a descriptor the caller keeps open
+    TransactionLogReader(int logFd, uint64_t from, uint64_t to, size_t bufferSize = defaultBufferSize)
+        : fd(logFd), ownsFd(false), buf(max<size_t>(bufferSize, 256)), bufOffset(from), limit(to) {}
+    ~TransactionLogReader() {
+        if (ownsFd) ::close(fd);
+    }
+
+    TransactionLogReader(const TransactionLogReader&) = delete;
+    TransactionLogReader& operator=(const TransactionLogReader&) = delete;
+
+    // Continue from another log offset
+    void seek(uint64_t offset) {
+        head = tail = 0;
+        bufOffset = offset;
+        eof = false;
+    }
+
+    // Next complete line (without its newline) and the offset it starts at;
+    // line stays valid until the next call. False at the end.
+    bool nextLine(string_view& line, uint64_t& offset) {
+        size_t scanned = 0;
+        for (;;) {
+            const char* start = buf.data() + head;
+            const void* nl = memchr(start + scanned, '\n', tail - head - scanned);
+            if (nl) {
+                offset = bufOffset + head;
+                line = string_view(start, (size_t)(static_cast<const char*>(nl) - start));
+                head += line.size() + 1;
+                return true;
+            }
+            scanned = tail - head;
+            if (!fill()) return false;
+        }
+    }
+
+    // Next well-formed record and the offset its line starts at; malformed
+    // lines are skipped and counted. False at the end. Reusing tx across
+    // calls makes this allocation-free.
+    bool next(Transaction& tx, uint64_t& offset) {
+        string_view line;
+        while (nextLine(line, offset)) {
+            if (line.empty()) continue;
+            if (tx.assignRecord(line)) return true;
+            ++malformed;
+        }
+        return false;
+    }
+
+    uint64_t position() const { return bufOffset + head; }   // just past the last line returned
+    size_t skipped() const { return malformed; }
+};
+
+// Persisted secondary index over the log (transactions.idx): every record
+// gets a fixed-width posting per account it touches, and each posting points
+// at the previous posting of the same account. "Last N records of X" is then
+// N posting reads plus N short log reads, wherever they are in the log. The
+// index is derived data: refresh() indexes what the log gained since it was
+// last persisted, and an index that does not fit the log -- shorter, or
+// another file (inode) than the one indexed -- is rebuilt.
+static const char historyIndexMagic[8] = {'B', 'A', 'N', 'K', 'I', 'D', 'X', '\0'};
+constexpr uint32_t historyIndexVersion = 2;
+
+struct HistoryIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t postingSize;        // sizeof(HistoryPosting) of the writer
+    uint64_t count;              // postings in the file
+    uint64_t logCovered;         // log offset indexed up to
+    uint64_t logInode;           // the log file the postings point into
+};
+
+struct HistoryPosting {
+    int32_t accNumber;
+    uint32_t reserved;
+    uint64_t logOffset;          // where the record's line starts
+    uint64_t prev;               // previous posting of accNumber, or noPosting
+};
+static_assert(sizeof(HistoryIndexHeader) == 40 && sizeof(HistoryPosting) == 24, "index layout is part of the file format");
+
+class TransactionHistory {
+private:
+    const string logPath;
+    int fd = -1;                               // the index file
+    int logFd = -1;                            // the log, kept open between queries
+    ino_t logInode = 0;
+    HistoryIndexHeader header;
+    unordered_map<int32_t, uint64_t> heads;    // accNumber -> its newest posting
+
+    static constexpr uint64_t noPosting = numeric_limits<uint64_t>::max();
+    static constexpr size_t postingBatch = 4096;
+
+    void reset() {
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, historyIndexMagic, sizeof header.magic);
+        header.version = historyIndexVersion;
+        header.postingSize = sizeof(HistoryPosting);
+        heads.clear();
+    }
+
+    void writeHeader() {
+        if (!pwriteAll(fd, &header, sizeof header, 0)) throw runtime_error("Unable to write transaction index.");
+    }
+
+    HistoryPosting posting(uint64_t i) const {
+        HistoryPosting p;
+        if (::pread(fd, &p, sizeof p, (off_t)(sizeof header + i * sizeof p)) != (ssize_t)sizeof p)
+            throw runtime_error("Unable to read transaction index.");
+        return p;
+    }
+
+    // The log's size; reopens it first if the path now names a new file,
+    // setting replaced when that file took the place of one read before
+    uint64_t openLog(bool& replaced) {
+        struct stat st;
+        replaced = false;
+        if (::stat(logPath.c_str(), &st) != 0) st.st_size = 0;
+        else if (logFd < 0 || st.st_ino != logInode) {
+            replaced = logFd >= 0;
+            int reopened = ::open(logPath.c_str(), O_RDONLY);
+            if (reopened < 0) throw runtime_error("Unable to open transaction log " + logPath + ".");
+            if (logFd >= 0) ::close(logFd);
+            logFd = reopened;
+            logInode = st.st_ino;
+        }
+        return (uint64_t)st.st_size;
+    }
+
+    // Rebuild heads from the persisted postings; false if the file does not fit the log
+    bool load() {
+        if (::pread(fd, &header, sizeof header, 0) != (ssize_t)sizeof header) return false;
+        if (memcmp(header.magic, historyIndexMagic, sizeof header.magic) != 0 ||
+            header.version != historyIndexVersion || header.postingSize != sizeof(HistoryPosting))
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof header + header.count * sizeof(HistoryPosting))
+            return false;
+        struct stat log;
+        bool hasLog = ::stat(logPath.c_str(), &log) == 0;
+        if (header.logCovered > (hasLog ? (uint64_t)log.st_size : 0)) return false;   // log truncated
+        if (header.logCovered > 0 && (uint64_t)log.st_ino != header.logInode) return false;   // log replaced
+        vector<HistoryPosting> chunk(postingBatch);
+        for (uint64_t i = 0; i < header.count; i += chunk.size()) {
+            size_t n = (size_t)min<uint64_t>(chunk.size(), header.count - i);
+            size_t bytes = n * sizeof(HistoryPosting);
+            if (::pread(fd, chunk.data(), bytes, (off_t)(sizeof header + i * sizeof(HistoryPosting))) != (ssize_t)bytes)
+                return false;
+            for (size_t k = 0; k < n; ++k) heads[chunk[k].accNumber] = i + k;
+        }
+        return true;
+    }
+
+public:
+    TransactionHistory(const string& indexPath, const string& logPath) : logPath(logPath) {
+        fd = ::open(indexPath.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) throw runtime_error("Unable to open transaction index " + indexPath + ".");
+        if (!load()) {
+            reset();
+            writeHeader();
+        }
+    }
+    ~TransactionHistory() {
+        ::close(fd);
+        if (logFd >= 0) ::close(logFd);
+    }
+
+    TransactionHistory(const TransactionHistory&) = delete;
+    TransactionHistory& operator=(const TransactionHistory&) = delete;
+
+    // Index the complete log records past the persisted offset
+    void refresh() {
+        bool replaced;
+        uint64_t logEnd = openLog(replaced);
+        // log truncated or replaced (here or by another process since load): rebuild
+        if (replaced || logEnd < header.logCovered || (header.logCovered > 0 && header.logInode != (uint64_t)logInode))
+            reset();
+        if (logEnd == header.logCovered) return;
+        try {
+            TransactionLogReader reader(logFd, header.logCovered, logEnd);
+            vector<HistoryPosting> batch;
+            batch.reserve(postingBatch);
+            auto writeBatch = [&] {
+                size_t bytes = batch.size() * sizeof(HistoryPosting);
+                if (!pwriteAll(fd, batch.data(), bytes, sizeof header + header.count * sizeof(HistoryPosting)))
+                    throw runtime_error("Unable to write transaction index.");
+                header.count += batch.size();
+                batch.clear();
+            };
+            Transaction tx;
+            uint64_t at;
+            auto post = [&](int accNumber) {
+                uint64_t& newest = heads.try_emplace(accNumber, noPosting).first->second;
+                batch.push_back({accNumber, 0, at, newest});
+                newest = header.count + batch.size() - 1;
+            };
+            while (reader.next(tx, at)) {
+                post(tx.getFromAcc());
+                if (tx.getToAcc() != tx.getFromAcc()) post(tx.getToAcc());
+                if (batch.size() >= postingBatch) writeBatch();
+            }
+            writeBatch();
+            // postings first, then the header that publishes them
+            if (::fdatasync(fd) != 0) throw runtime_error("Unable to write transaction index.");
+            header.logCovered = reader.position();
+            header.logInode = (uint64_t)logInode;
+            writeHeader();
+        } catch (...) {
+            reset();   // start over on the next refresh rather than trust a half-written index
+            throw;
+        }
+    }
+
+    // Log offsets of the last n records touching accNumber, newest first
+    vector<uint64_t> recentOffsets(int accNumber, size_t n) const {
+        vector<uint64_t> out;
+        auto it = heads.find(accNumber);
+        for (uint64_t p = it == heads.end() ? noPosting : it->second; p != noPosting && out.size() < n;) {
+            HistoryPosting e = posting(p);
+            out.push_back(e.logOffset);
+            p = e.prev;
+        }
+        return out;
+    }
+
+    // The last n records touching accNumber, newest first
+    vector<Transaction> recent(int accNumber, size_t n) const {
+        vector<Transaction> out;
+        vector<uint64_t> offsets = recentOffsets(accNumber, n);
+        if (offsets.empty() || logFd < 0) return out;   // nothing indexed since open: refresh() first
+        out.reserve(offsets.size());
+        TransactionLogReader reader(logFd, 0, header.logCovered, 256);
+        Transaction tx;
+        uint64_t at;
+        for (uint64_t off : offsets) {
+            reader.seek(off);
+            if (reader.next(tx, at) && at == off) out.push_back(tx);
+        }
+        return out;
+    }
+};
+
+// --------------------------- 5f) BATCH INTEREST ---------------------------------
+// Month-end accrual over the whole balance column. Each product code maps to
+// an annual rate; the plan turns every rate into one growth factor over the
+// accrual period -- calculateMatured's (1 + r*t) - 1 for simple interest, or
+// (1 + r/m)^(m*t) - 1 for interest compounded m times a year -- and
+// kernels::accrue applies the factors to the balances.
+enum class InterestMethod { Simple, Compound };
+
+struct InterestPlan {
+    InterestMethod method = InterestMethod::Simple;
+    double years = 1.0 / 12;                 // accrual period
+    int periodsPerYear = 12;                 // compounding frequency (Compound only)
+    double defaultRatePercent = 0;           // p.a., for products without their own rate
+    vector<double> productRatePercent;       // p.a., indexed by product code
+};
+
+// factors[p] for every product code with its own rate, then one for the default
+static vector<double> interestFactors(const InterestPlan& plan) {
+    if (!(plan.years >= 0) || (plan.method == InterestMethod::Compound && plan.periodsPerYear <= 0))
+        throw invalid_argument("Invalid interest period.");
+    auto factor = [&](double ratePercent) {
+        double r = ratePercent / 100.0;
+        double f = plan.method == InterestMethod::Simple
+                       ? r * plan.years
+                       : pow(1 + r / plan.periodsPerYear, plan.periodsPerYear * plan.years) - 1;
+        // keeps interest within the range the kernel converts exactly
+        if (!(f > -1 && f < 1)) throw invalid_argument("Interest rate out of range for one accrual period.");
+        return f;
+    };
+    vector<double> factors;
+    factors.reserve(plan.productRatePercent.size() + 1);
+    for (double rate : plan.productRatePercent) factors.push_back(factor(rate));
+    factors.push_back(factor(plan.defaultRatePercent));
+    return factors;
+}
+
+// --------------------------- 5g) METRICS -----------------------------------------
+// Counters and latency histograms for AccountManager's hot paths. Recording
+// never locks: every thread is assigned one of a fixed set of cache-line
+// aligned cells and bumps relaxed atomics in it, so threads on different
+// cells share no cache lines. A snapshot sums the cells; it is not one instant
+// across all counters, but no increment is ever lost.
+constexpr size_t txStatusCount = (size_t)TxStatus::QueueFull + 1;   // keep in step with TxStatus
+
+// Small dense number per thread, assigned on first use, for picking a per-thread cell
+inline size_t threadOrdinal() {
+    static atomic<size_t> nextThread{0};
+    thread_local size_t mine = nextThread.fetch_add(1, memory_order_relaxed);
+    return mine;
+}
+
+// HDR-style log-linear buckets over nanoseconds: linear below 8, then 8
+// sub-buckets per power of two, so a value is reported within 12.5%.
+// Values past 2^40 ns (about 18 minutes) land in the last bucket.
+struct HistogramBuckets {
+    static constexpr unsigned subBits = 3;
+    static constexpr unsigned maxExponent = 40;
+    static constexpr size_t count = ((maxExponent - subBits + 1) << subBits) + (1u << subBits);
+
+    static size_t of(uint64_t v) {
+        if (v < (1u << subBits)) return (size_t)v;
+        unsigned e = 63 - (unsigned)__builtin_clzll(v);
+        if (e > maxExponent) return count - 1;
+        return ((size_t)(e - subBits + 1) << subBits) + ((v >> (e - subBits)) & ((1u << subBits) - 1));
+    }
+    // Largest value that lands in bucket b
+    static uint64_t upper(size_t b) {
+        if (b < (1u << subBits)) return b;
+        unsigned e = (unsigned)(b >> subBits) + subBits - 1;
+        uint64_t sub = b & ((1u << subBits) - 1);
+        return (((1ull << subBits) + sub + 1) << (e - subBits)) - 1;
+    }
+};
+
+struct HistogramSnapshot {
+    vector<uint64_t> buckets = vector<uint64_t>(HistogramBuckets::count);
+    uint64_t count = 0;
+    uint64_t sumNanos = 0;
+    uint64_t maxNanos = 0;
+
+    double meanNanos() const { return count ? (double)sumNanos / count : 0; }
+
+    // Single-writer counterpart of LatencyHistogram::record, for a thread's own snapshot
+    void record(uint64_t nanos) {
+        ++buckets[HistogramBuckets::of(nanos)];
+        ++count;
+        sumNanos += nanos;
+        maxNanos = max(maxNanos, nanos);
+    }
+
+    void merge(const HistogramSnapshot& o) {
+        for (size_t b = 0; b < buckets.size(); ++b) buckets[b] += o.buckets[b];
+        count += o.count;
+        sumNanos += o.sumNanos;
+        maxNanos = max(maxNanos, o.maxNanos);
+    }
+
+    // Smallest bucket bound at or below which a fraction q of the samples lie
+    uint64_t percentile(double q) const {
+        if (count == 0) return 0;
+        uint64_t rank = (uint64_t)ceil(min(max(q, 0.0), 1.0) * count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            seen += buckets[b];
+            if (seen >= max<uint64_t>(rank, 1)) return min(HistogramBuckets::upper(b), maxNanos);
+        }
+        return maxNanos;
+    }
+};
+
+class LatencyHistogram {
+private:
+    atomic<uint64_t> buckets[HistogramBuckets::count] = {};
+    atomic<uint64_t> sum{0};
+    atomic<uint64_t> maximum{0};
+
+public:
+    void record(uint64_t nanos) {
+        buckets[HistogramBuckets::of(nanos)].fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(nanos, memory_order_relaxed);
+        uint64_t m = maximum.load(memory_order_relaxed);
+        while (nanos > m && !maximum.compare_exchange_weak(m, nanos, memory_order_relaxed)) {}
+    }
+
+    void addTo(HistogramSnapshot& s) const {
+        for (size_t b = 0; b < HistogramBuckets::count; ++b) {
+            uint64_t n = buckets[b].load(memory_order_relaxed);
+            s.buckets[b] += n;
+            s.count += n;
+        }
+        s.sumNanos += sum.load(memory_order_relaxed);
+        s.maxNanos = max(s.maxNanos, maximum.load(memory_order_relaxed));
+    }
+};
+
+struct alignas(64) MetricCell {
+    atomic<uint64_t> transfersApplied{0};
+    atomic<uint64_t> transfersRejected[txStatusCount] = {};   // by reason
+    atomic<uint64_t> logBytes{0};
+    LatencyHistogram transfer, load, save, logAppend;
+};
+
+struct MetricsSnapshot {
+    uint64_t transfersApplied = 0;
+    uint64_t transfersRejected[txStatusCount] = {};           // by TxStatus; [Ok] stays 0
+    uint64_t logAppends = 0;
+    uint64_t logBytes = 0;
+    size_t accountLinesSkipped = 0;                           // malformed lines found at load
+    size_t logLinesSkipped = 0;
+    HistogramSnapshot transfer;    // tryTransfer/transferFunds, rejections included
+    HistogramSnapshot load;        // construction and loadAllAccounts
+    HistogramSnapshot save;        // every checkpoint write
+    HistogramSnapshot logAppend;   // append until durable
+
+    uint64_t transfersRejectedTotal() const {
+        uint64_t n = 0;
+        for (uint64_t v : transfersRejected) n += v;
+        return n;
+    }
+
+    // Prometheus text exposition format, for a scrape endpoint to serve as is
+    string toText() const {
+        string out;
+        char line[160];
+        auto emit = [&](const char* fmt, auto... args) {
+            snprintf(line, sizeof line, fmt, args...);
+            out += line;
+        };
+        emit("bank_transfers_applied_total %llu\n", (unsigned long long)transfersApplied);
+        for (size_t s = 1; s < txStatusCount; ++s) {
+            string reason = statusMessage((TxStatus)s);
+            for (char& c : reason) c = c == ' ' ? '_' : (char)tolower((unsigned char)c);
+            emit("bank_transfers_rejected_total{reason=\"%s\"} %llu\n", reason.c_str(),
+                 (unsigned long long)transfersRejected[s]);
+        }
+        emit("bank_log_appends_total %llu\n", (unsigned long long)logAppends);
+        emit("bank_log_bytes_total %llu\n", (unsigned long long)logBytes);
+        emit("bank_lines_skipped_total{file=\"accounts\"} %zu\n", accountLinesSkipped);
+        emit("bank_lines_skipped_total{file=\"log\"} %zu\n", logLinesSkipped);
+        const pair<const char*, const HistogramSnapshot*> ops[] = {
+            {"transfer", &transfer}, {"load", &load}, {"save", &save}, {"log_append", &logAppend}};
+        for (const auto& op : ops) {
+            for (double q : {0.5, 0.9, 0.99, 0.999})
+                emit("bank_latency_seconds{op=\"%s\",quantile=\"%g\"} %.9f\n", op.first, q,
+                     op.second->percentile(q) * 1e-9);
+            emit("bank_latency_seconds_sum{op=\"%s\"} %.9f\n", op.first, op.second->sumNanos * 1e-9);
+            emit("bank_latency_seconds_count{op=\"%s\"} %llu\n", op.first, (unsigned long long)op.second->count);
+        }
+        return out;
+    }
+};
+
+class Metrics {
+private:
+    static constexpr size_t cellCount = 16;
+    unique_ptr<MetricCell[]> cells{new MetricCell[cellCount]};
+
+public:
+    // The calling thread's cell
+    MetricCell& local() { return cells[threadOrdinal() % cellCount]; }
+
+    void snapshot(MetricsSnapshot& s) const {
+        for (size_t i = 0; i < cellCount; ++i) {
+            const MetricCell& c = cells[i];
+            s.transfersApplied += c.transfersApplied.load(memory_order_relaxed);
+            for (size_t r = 0; r < txStatusCount; ++r)
+                s.transfersRejected[r] += c.transfersRejected[r].load(memory_order_relaxed);
+            s.logBytes += c.logBytes.load(memory_order_relaxed);
+            c.transfer.addTo(s.transfer);
+            c.load.addTo(s.load);
+            c.save.addTo(s.save);
+            c.logAppend.addTo(s.logAppend);
+        }
+        s.logAppends = s.logAppend.count;
+    }
+};
+
+inline uint64_t nanosSince(chrono::steady_clock::time_point t0) {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+}
+
+// --------------------------- 5h) HOT ACCOUNTS ------------------------------------
+// Split counter for an account that most transfers pay into (a settlement or
+// merchant account). Money moving in is added to one of several sub-balances
+// -- the calling thread's, each on its own cache line -- without touching the
+// account's stripe. The account's row in the table keeps the rest of its
+// balance; its true balance is the row plus every part. Money moving out is
+// reserved from the calling thread's part when that part holds enough, so the
+// insufficient-funds rule never looks at an overstated balance; otherwise the
+// parts are folded into the row under the account's stripe and checked there.
+class HotBalance {
+private:
+    struct alignas(64) Part { atomic<int64_t> minor{0}; };
+    const int acc;
+    const size_t count;
+    unique_ptr<Part[]> parts;
+
+    Part& local() { return parts[threadOrdinal() % count]; }
+
+public:
+    HotBalance(int accNumber, unsigned partCount)
+        : acc(accNumber), count(max(1u, partCount)), parts(new Part[count]) {}
+
+    int accNumber() const { return acc; }
+
+    void credit(int64_t amt) { local().minor.fetch_add(amt, memory_order_relaxed); }
+
+    // Take amt from the calling thread's part if it holds that much
+    bool tryReserve(int64_t amt) {
+        atomic<int64_t>& p = local().minor;
+        int64_t cur = p.load(memory_order_relaxed);
+        while (cur >= amt) {
+            if (p.compare_exchange_weak(cur, cur - amt, memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    // Sum of the parts, not yet folded into the row
+    int64_t pending() const {
+        int64_t total = 0;
+        for (size_t i = 0; i < count; ++i) total += parts[i].minor.load(memory_order_relaxed);
+        return total;
+    }
+
+    // Empty every part; returns what they held. Caller holds the account's stripe.
+    int64_t drain() {
+        int64_t total = 0;
+        for (size_t i = 0; i < count; ++i) total += parts[i].minor.exchange(0, memory_order_relaxed);
+        return total;
+    }
+};
+
+// The designated hot accounts. A set is immutable once published; a change
+// publishes a new one (under AllStripesLock) and old sets live on until the
+// manager goes, so the transfer path can consult the current set lock-free.
+struct HotSet {
+    vector<HotBalance*> accounts;
+
+    HotBalance* find(int accNumber) const {
+        for (HotBalance* h : accounts)
+            if (h->accNumber() == accNumber) return h;
+        return nullptr;
+    }
+};
+
+// --------------------------- 5i) RECONCILIATION ----------------------------------
+// Ledger verification: replaying the log range [baseline.logOffset(),
+// current.logOffset()) onto a baseline snapshot must reproduce the current
+// snapshot, balance for balance, and money may enter only by opening an
+// account or by a deposit, and leave only by a withdrawal. The range is cut at line boundaries into one chunk per thread;
+// each chunk is streamed through its own TransactionLogReader and folded into
+// net per-account deltas in exact int64 minor units (a dense column over the
+// baseline's accounts, a map for the rest). An opening record resets a
+// balance, so a chunk also notes each opened account's delta at its first and
+// last opening; merging the chunks in log order then gives exactly what a
+// sequential replay gives. Memory is a delta column per thread plus the
+// accounts the range opens; the log itself is never held.
+struct ReconcileConfig {
+    unsigned threads = 0;                // 0: one per hardware thread
+    size_t maxMismatches = 100;          // mismatches listed in the report (all are counted)
+    size_t readBufferSize = 1 << 20;     // per-thread log read buffer
+};
+
+struct ReconcileMismatch {
+    int accNumber;
+    bool expected;                       // replay says the account exists
+    bool actual;                         // the current snapshot has it
+    int64_t expectedMinor;
+    int64_t actualMinor;
+};
+
+struct ReconcileReport {
+    uint64_t logFrom = 0, logTo = 0;     // the log range replayed
+    size_t records = 0;                  // log records folded
+    size_t malformedLines = 0;           // skipped, as replay skips them
+    size_t accountsChecked = 0;
+    int64_t baselineTotal = 0;           // all totals in minor units
+    int64_t openedTotal = 0;             // opening balances of accounts the range created
+    int64_t expectedTotal = 0;           // what replay gives
+    int64_t actualTotal = 0;             // what the current snapshot holds
+    size_t strayLegs = 0;                // transfer legs naming an account that did not exist then
+    int64_t strayTotal = 0;              // their net amount, which replay drops
+    size_t reopened = 0;                 // openings of an account that already existed
+    int64_t depositedTotal = 0;          // paid in from outside the bank
+    int64_t withdrawnTotal = 0;          // paid out
+    int64_t interestTotal = 0;           // accrued, net of negative rates
+    size_t mismatchCount = 0;
+    vector<ReconcileMismatch> mismatches;   // the first maxMismatches
+
+    bool balancesMatch() const { return mismatchCount == 0; }
+    // Transfers only moved money: the current total is the baseline's plus the
+    // new accounts' openings, the deposits and the interest, less the withdrawals
+    bool conserved() const {
+        return strayLegs == 0 && reopened == 0 &&
+               actualTotal == baselineTotal + openedTotal + depositedTotal + interestTotal - withdrawnTotal;
+    }
+    bool ok() const { return balancesMatch() && conserved() && malformedLines == 0; }
+
+    string toText() const {
+        auto money = [](int64_t minor) { return Money::fromMinor(minor).toString(); };
+        string out = "log [" + to_string(logFrom) + ", " + to_string(logTo) + "): " + to_string(records) +
+                     " records, " + to_string(malformedLines) + " malformed lines\n";
+        out += "accounts checked: " + to_string(accountsChecked) + ", mismatches: " + to_string(mismatchCount) + "\n";
+        out += "baseline " + money(baselineTotal) + " + opened " + money(openedTotal) + " + deposited " +
+               money(depositedTotal) + " + interest " + money(interestTotal) + " - withdrawn " +
+               money(withdrawnTotal) + ", replayed " +
+               money(expectedTotal) + ", current " + money(actualTotal) + "\n";
+        out += "stray legs: " + to_string(strayLegs) + " (" + money(strayTotal) + "), reopened: " + to_string(reopened) +
+               ", conserved: " + (conserved() ? "yes" : "no") + "\n";
+        for (const ReconcileMismatch& m : mismatches) {
+            out += "  account " + to_string(m.accNumber) + ": expected " + (m.expected ? money(m.expectedMinor) : "none") +
+                   ", current " + (m.actual ? money(m.actualMinor) : "none") + "\n";
+        }
+        return out;
+    }
+};
+
+namespace reconcile {
+
+static constexpr string_view openNote = "open:";
+static constexpr string_view productNote = "product:";
+static constexpr string_view depositNote = "deposit";
+static constexpr string_view withdrawalNote = "withdrawal";
+static constexpr string_view interestNote = "interest";
+
+// What a log range did to an account beyond its net delta
+struct Openings {
+    int64_t delta = 0;                   // accounts outside the baseline (baseline deltas are dense)
+    uint64_t legs = 0;                   // ditto, transfer legs
+    uint64_t opens = 0;
+    int64_t atFirstOpen = 0;             // delta when the first opening was read
+    int64_t atLastOpen = 0;
+    uint64_t legsAtFirstOpen = 0;
+    int64_t firstOpen = 0;               // the opening balances
+    int64_t lastOpen = 0;
+    bool current = false;                // found in the current snapshot (final comparison only)
+};
+
+struct Chunk {
+    vector<int64_t> delta;               // baseline slot -> net change
+    unordered_map<int32_t, Openings> others;   // opened accounts and those outside the baseline
+    size_t records = 0;
+    size_t malformed = 0;
+    int64_t deposited = 0;
+    int64_t withdrawn = 0;
+    int64_t interest = 0;
+};
+
+inline void addExact(int64_t& to, int64_t v) {
+    if (__builtin_add_overflow(to, v, &to)) throw runtime_error("Reconciliation overflowed the fixed-point range.");
+}
+
+// First line start at or after offset (offset itself when a line starts there)
+static uint64_t lineStartFrom(int fd, uint64_t offset, uint64_t end) {
+    if (offset == 0 || offset >= end) return min(offset, end);
+    char buf[4096];
+    for (uint64_t at = offset - 1; at < end;) {
+        ssize_t n;
+        do n = ::pread(fd, buf, (size_t)min<uint64_t>(sizeof buf, end - at), (off_t)at); while (n < 0 && errno == EINTR);
+        if (n < 0) throw runtime_error("Unable to read transaction file.");
+        if (n == 0) break;
+        if (const void* nl = memchr(buf, '\n', (size_t)n)) return at + (uint64_t)(static_cast<const char*>(nl) - buf) + 1;
+        at += (uint64_t)n;
+    }
+    return end;
+}
+
+static void fold(const AccountIndex& baseline, int fd, uint64_t from, uint64_t to, size_t bufferSize, Chunk& c) {
+    TransactionLogReader reader(fd, from, to, bufferSize);
+    auto leg = [&](int32_t acc, int64_t amount) {
+        uint32_t slot = baseline.find(acc);
+        if (slot != AccountIndex::missing) {
+            addExact(c.delta[slot], amount);
+        } else {
+            Openings& o = c.others[acc];
+            addExact(o.delta, amount);
+            ++o.legs;
+        }
+    };
+    string_view line, note;
+    uint64_t at;
+    int fromAcc, toAcc;
+    Money amount;
+    while (reader.nextLine(line, at)) {
+        if (line.empty()) continue;
+        if (!Transaction::tryParseRecord(line, fromAcc, toAcc, amount, note)) {
+            ++c.malformed;
+            continue;
+        }
+        ++c.records;
+        if (fromAcc == 0 && note.substr(0, productNote.size()) == productNote) continue;
+        if (fromAcc == 0 && note.substr(0, openNote.size()) == openNote) {
+            uint32_t slot = baseline.find(toAcc);
+            Openings& o = c.others[toAcc];
+            int64_t now = slot != AccountIndex::missing ? c.delta[slot] : o.delta;
+            if (o.opens++ == 0) {
+                o.atFirstOpen = now;
+                o.legsAtFirstOpen = o.legs;
+                o.firstOpen = amount.minorUnits();
+            }
+            o.atLastOpen = now;
+            o.lastOpen = amount.minorUnits();
+            continue;
+        }
+        // account 0 is the outside world: only the named account has a leg
+        if (fromAcc == 0 && note == depositNote) {
+            addExact(c.deposited, amount.minorUnits());
+            leg(toAcc, amount.minorUnits());
+            continue;
+        }
+        if (toAcc == 0 && note == withdrawalNote) {
+            addExact(c.withdrawn, amount.minorUnits());
+            leg(fromAcc, -amount.minorUnits());
+            continue;
+        }
+        if ((fromAcc == 0 || toAcc == 0) && note == interestNote) {
+            int64_t v = fromAcc == 0 ? amount.minorUnits() : -amount.minorUnits();
+            addExact(c.interest, v);
+            leg(fromAcc == 0 ? toAcc : fromAcc, v);
+            continue;
+        }
+        leg(fromAcc, -amount.minorUnits());
+        leg(toAcc, amount.minorUnits());
+    }
+}
+
+// Append chunk c (the log after acc's range) to acc
+static void merge(const AccountIndex& baseline, Chunk& acc, const Chunk& c) {
+    for (const auto& [accNo, later] : c.others) {
+        uint32_t slot = baseline.find(accNo);
+        Openings& o = acc.others[accNo];
+        int64_t before = slot != AccountIndex::missing ? acc.delta[slot] : o.delta;
+        if (later.opens) {
+            if (o.opens == 0) {
+                o.atFirstOpen = before + later.atFirstOpen;
+                o.legsAtFirstOpen = o.legs + later.legsAtFirstOpen;
+                o.firstOpen = later.firstOpen;
+            }
+            o.atLastOpen = before + later.atLastOpen;
+            o.lastOpen = later.lastOpen;
+            o.opens += later.opens;
+        }
+        addExact(o.delta, later.delta);
+        o.legs += later.legs;
+    }
+    for (size_t i = 0; i < acc.delta.size(); ++i) addExact(acc.delta[i], c.delta[i]);
+    acc.records += c.records;
+    acc.malformed += c.malformed;
+    addExact(acc.deposited, c.deposited);
+    addExact(acc.withdrawn, c.withdrawn);
+    addExact(acc.interest, c.interest);
+}
+
+} // namespace reconcile
+
+// Replay logPath's range [baseline.logOffset(), current.logOffset()) onto
+// baseline and compare the outcome with current (see above). The log must
+// hold that whole range; throws if it cannot be read.
+static ReconcileReport reconcileLedger(const AccountSnapshot& baseline, const string& logPath,
+                                       const AccountSnapshot& current, const ReconcileConfig& cfg = {}) {
+    ReconcileReport rep;
+    rep.logFrom = baseline.logOffset();
+    rep.logTo = current.logOffset();
+    if (rep.logTo < rep.logFrom) throw invalid_argument("The current snapshot predates the baseline.");
+
+    const size_t n = baseline.size();
+    AccountIndex index;
+    index.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (index.find(baseline.accNumber(i)) == AccountIndex::missing) index.insert(baseline.accNumber(i), (uint32_t)i);
+        reconcile::addExact(rep.baselineTotal, baseline.balanceColumn()[i]);
+    }
+
+    reconcile::Chunk total;
+    total.delta.assign(n, 0);
+    if (rep.logTo > rep.logFrom) {
+        int fd = ::open(logPath.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Unable to open transaction log " + logPath + ".");
+        try {
+            uint64_t end = min<uint64_t>(rep.logTo, fileSize(logPath));
+            if (end < rep.logTo) throw runtime_error("Transaction log " + logPath + " is shorter than the range to reconcile.");
+            const uint64_t minChunk = 4 << 20;
+            size_t chunks = cfg.threads == 0 ? max(1u, thread::hardware_concurrency()) : cfg.threads;
+            chunks = (size_t)max<uint64_t>(1, min<uint64_t>(chunks, (end - rep.logFrom) / minChunk));
+            vector<uint64_t> cuts(chunks + 1);
+            cuts[0] = rep.logFrom;
+            cuts[chunks] = end;
+            for (size_t k = 1; k < chunks; ++k)
+                cuts[k] = reconcile::lineStartFrom(fd, rep.logFrom + (end - rep.logFrom) * k / chunks, end);
+            if (chunks == 1) {
+                reconcile::fold(index, fd, cuts[0], cuts[1], cfg.readBufferSize, total);
+            } else {
+                vector<reconcile::Chunk> parts(chunks - 1);
+                ThreadPool pool((unsigned)chunks);
+                vector<future<void>> done;
+                done.push_back(pool.submit([&] { reconcile::fold(index, fd, cuts[0], cuts[1], cfg.readBufferSize, total); }));
+                for (size_t k = 1; k < chunks; ++k) {
+                    done.push_back(pool.submit([&, k] {
+                        parts[k - 1].delta.assign(n, 0);
+                        reconcile::fold(index, fd, cuts[k], cuts[k + 1], cfg.readBufferSize, parts[k - 1]);
+                    }));
+                }
+                for (auto& d : done) d.get();
+                for (reconcile::Chunk& c : parts) {
+                    reconcile::merge(index, total, c);
+                    c = reconcile::Chunk();
+                }
+            }
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+    rep.records = total.records;
+    rep.malformedLines = total.malformed;
+    rep.depositedTotal = total.deposited;
+    rep.withdrawnTotal = total.withdrawn;
+    rep.interestTotal = total.interest;
+
+    // Expected outcome: a baseline account's balance plus its delta since its
+    // last opening (or since the baseline); an outside account exists only
+    // once opened, and its legs before that are dropped, as replay drops them
+    vector<int64_t> expected(baseline.balanceColumn(), baseline.balanceColumn() + n);
+    for (size_t i = 0; i < n; ++i) reconcile::addExact(expected[i], total.delta[i]);
+    for (auto& [accNo, o] : total.others) {
+        uint32_t slot = index.find(accNo);
+        if (slot != AccountIndex::missing) {
+            rep.reopened += o.opens;
+            if (o.opens) expected[slot] = o.lastOpen + (total.delta[slot] - o.atLastOpen);
+            continue;
+        }
+        rep.strayLegs += o.opens ? o.legsAtFirstOpen : o.legs;
+        reconcile::addExact(rep.strayTotal, o.opens ? o.atFirstOpen : o.delta);
+        if (o.opens) {
+            rep.reopened += o.opens - 1;
+            reconcile::addExact(rep.openedTotal, o.firstOpen);
+            o.delta = o.lastOpen + (o.delta - o.atLastOpen);   // now the expected balance
+        }
+    }
+
+    auto mismatch = [&](int accNo, bool hasExpected, int64_t e, bool hasActual, int64_t a) {
+        if (rep.mismatchCount++ < cfg.maxMismatches) rep.mismatches.push_back({accNo, hasExpected, hasActual, e, a});
+    };
+    for (size_t i = 0; i < n; ++i) reconcile::addExact(rep.expectedTotal, expected[i]);
+    for (const auto& [accNo, o] : total.others)
+        if (index.find(accNo) == AccountIndex::missing && o.opens) reconcile::addExact(rep.expectedTotal, o.delta);
+
+    // Every current account must be expected with its balance; every expected one must be current
+    vector<uint8_t> seen(n, 0);
+    for (size_t i = 0; i < current.size(); ++i) {
+        int accNo = current.accNumber(i);
+        int64_t actual = current.balanceColumn()[i];
+        reconcile::addExact(rep.actualTotal, actual);
+        ++rep.accountsChecked;
+        uint32_t slot = index.find(accNo);
+        if (slot != AccountIndex::missing) {
+            seen[slot] = 1;
+            if (expected[slot] != actual) mismatch(accNo, true, expected[slot], true, actual);
+            continue;
+        }
+        auto it = total.others.find(accNo);
+        if (it == total.others.end() || it->second.opens == 0) {
+            mismatch(accNo, false, 0, true, actual);
+            continue;
+        }
+        it->second.current = true;
+        if (it->second.delta != actual) mismatch(accNo, true, it->second.delta, true, actual);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (seen[i] || index.find(baseline.accNumber(i)) != i) continue;
+        ++rep.accountsChecked;
+        mismatch(baseline.accNumber(i), true, expected[i], false, 0);
+    }
+    for (const auto& [accNo, o] : total.others) {
+        if (o.current || o.opens == 0 || index.find(accNo) != AccountIndex::missing) continue;
+        ++rep.accountsChecked;
+        mismatch(accNo, true, o.delta, false, 0);
+    }
+    return rep;
+}
+
+// --------------------------- 5j) LOG ARCHIVE -------------------------------------
+// Compacted form of a sealed log segment (transactions.txt.<seq>.arc), written
+// by AccountManager::compactLog. Records are stored column by column: from,
+// to and amount as zigzag varints of the change from the previous record,
+// notes as varint ids into a table of the distinct notes. A transfer between
+// nearby accounts with a repeated amount then takes a few bytes instead of a
+// text line, and a query for one account decodes the account columns only
+// until it knows which records it wants. Malformed lines are dropped, as
+// replay drops them. The archive is history only: the snapshot written
+// before the segment was sealed already holds its effect.
+static const char logArchiveMagic[8] = {'B', 'A', 'N', 'K', 'A', 'R', 'C', '\0'};
+constexpr uint32_t logArchiveVersion = 1;
+
+struct LogArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t records;
+    uint64_t logBytes;           // size of the text segment archived
+    uint64_t notes;              // entries in the note table
+    uint64_t columnBytes[4];     // from, to, amount and note id columns; the note table follows
+    uint64_t checksum;           // fnv1a of everything after the header
+};
+static_assert(sizeof(LogArchiveHeader) == 80, "archive layout is part of the file format");
+
+namespace varint {
+
+inline void put(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+inline void putSigned(string& out, int64_t v) { put(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+
+inline bool get(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = (uint8_t)*p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool getSigned(const char*& p, const char* end, int64_t& v) {
+    uint64_t u;
+    if (!get(p, end, u)) return false;
+    v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return true;
+}
+
+} // namespace varint
+
+struct LogArchiveInfo {
+    uint64_t records = 0;
+    uint64_t bytes = 0;          // archive file size
+};
+
+// Archive the log records in [0, end) of logPath into archivePath (atomically)
+static LogArchiveInfo writeLogArchive(const string& logPath, uint64_t end, const string& archivePath) {
+    string cols[4];
+    string noteTable;
+    unordered_map<string, uint32_t> noteIds;
+    int64_t prev[3] = {0, 0, 0};
+    uint64_t records = 0;
+    {
+        TransactionLogReader reader(logPath, 0, end, 1 << 20);
+        string_view line, note;
+        uint64_t at;
+        int fromAcc, toAcc;
+        Money amount;
+        while (reader.nextLine(line, at)) {
+            if (line.empty() || !Transaction::tryParseRecord(line, fromAcc, toAcc, amount, note)) continue;
+            int64_t v[3] = {fromAcc, toAcc, amount.minorUnits()};
+            for (int c = 0; c < 3; ++c) {
+                varint::putSigned(cols[c], v[c] - prev[c]);
+                prev[c] = v[c];
+            }
+            auto id = noteIds.try_emplace(string(note), (uint32_t)noteIds.size());
+            if (id.second) {
+                varint::put(noteTable, note.size());
+                noteTable.append(note.data(), note.size());
+            }
+            varint::put(cols[3], id.first->second);
+            ++records;
+        }
+    }
+    LogArchiveHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, logArchiveMagic, sizeof h.magic);
+    h.version = logArchiveVersion;
+    h.records = records;
+    h.logBytes = end;
+    h.notes = noteIds.size();
+    string out(sizeof h, '\0');
+    for (int c = 0; c < 4; ++c) {
+        h.columnBytes[c] = cols[c].size();
+        out += cols[c];
+        string().swap(cols[c]);
+    }
+    out += noteTable;
+    h.checksum = fnv1a(out.data() + sizeof h, out.size() - sizeof h);
+    memcpy(&out[0], &h, sizeof h);
+    writeFileAtomically(archivePath, out);
+    return {records, out.size()};
+}
+
+// Read-only view of one archive; the constructor verifies the checksum
+class LogArchive {
+private:
+    MappedFile file;
+    LogArchiveHeader h;
+    const char* cols[5];             // column starts; cols[4] is the note table
+    vector<string_view> notes;
+
+    [[noreturn]] static void corrupt() { throw runtime_error("Corrupt transaction log archive."); }
+
+public:
+    explicit LogArchive(const string& path) : file(path) {
+        if (file.size() < sizeof h) corrupt();
+        memcpy(&h, file.data(), sizeof h);
+        if (memcmp(h.magic, logArchiveMagic, sizeof h.magic) != 0 || h.version != logArchiveVersion) corrupt();
+        const char* p = file.data() + sizeof h;
+        const char* end = file.data() + file.size();
+        if (fnv1a(p, (size_t)(end - p)) != h.checksum) corrupt();
+        for (int c = 0; c < 4; ++c) {
+            cols[c] = p;
+            if (h.columnBytes[c] > (uint64_t)(end - p)) corrupt();
+            p += h.columnBytes[c];
+        }
+        cols[4] = p;
+        notes.reserve(h.notes);
+        for (uint64_t i = 0; i < h.notes; ++i) {
+            uint64_t len;
+            if (!varint::get(p, end, len) || len > (uint64_t)(end - p)) corrupt();
+            notes.emplace_back(p, (size_t)len);
+            p += len;
+        }
+    }
+
+    uint64_t records() const { return h.records; }
+    uint64_t logBytes() const { return h.logBytes; }
+
+    // Every record in log order, as onRecord(from, to, amount, note)
+    template<typename F>
+    void forEach(F&& onRecord) const {
+        const char* p[4] = {cols[0], cols[1], cols[2], cols[3]};
+        int64_t v[3] = {0, 0, 0};
+        for (uint64_t i = 0; i < h.records; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                int64_t d;
+                if (!varint::getSigned(p[c], cols[c + 1], d)) corrupt();
+                v[c] += d;
+            }
+            uint64_t id;
+            if (!varint::get(p[3], cols[4], id) || id >= notes.size()) corrupt();
+            onRecord((int)v[0], (int)v[1], Money::fromMinor(v[2]), notes[id]);
+        }
+    }
+
+    // Append the last n records touching accNumber to out, newest first. The
+    // account columns are scanned first; amounts and notes are decoded for
+    // the records picked only.
+    void recentFor(int accNumber, size_t n, vector<Transaction>& out) const {
+        if (n == 0) return;
+        vector<uint64_t> picked;                 // ring of the last n matching record numbers
+        size_t next = 0;
+        const char* p[2] = {cols[0], cols[1]};
+        int64_t v[2] = {0, 0};
+        for (uint64_t i = 0; i < h.records; ++i) {
+            for (int c = 0; c < 2; ++c) {
+                int64_t d;
+                if (!varint::getSigned(p[c], cols[c + 1], d)) corrupt();
+                v[c] += d;
+            }
+            if (v[0] != accNumber && v[1] != accNumber) continue;
+            if (picked.size() < n) picked.push_back(i);
+            else picked[next] = i;
+            next = (next + 1) % n;
+        }
+        if (picked.empty()) return;
+        rotate(picked.begin(), picked.begin() + (picked.size() < n ? 0 : next), picked.end());
+        vector<Transaction> found;
+        found.reserve(picked.size());
+        size_t k = 0;
+        uint64_t i = 0;
+        forEach([&](int from, int to, Money amount, string_view note) {
+            if (k < picked.size() && picked[k] == i) {
+                found.emplace_back(from, to, amount, string(note));
+                ++k;
+            }
+            ++i;
+        });
+        out.insert(out.end(), found.rbegin(), found.rend());
+    }
+};
+
+// The last n records of an open text log segment naming accNumber, newest
+// first, appended to out: recentFor for a segment not archived yet
+static void recentInLogText(int fd, int accNumber, size_t n, vector<Transaction>& out) {
+    if (n == 0) return;
+    TransactionLogReader reader(fd, 0, numeric_limits<uint64_t>::max());
+    deque<Transaction> found;
+    Transaction tx;
+    uint64_t at;
+    while (reader.next(tx, at)) {
+        if (tx.getFromAcc() != accNumber && tx.getToAcc() != accNumber) continue;
+        if (found.size() == n) found.pop_front();
+        found.push_back(tx);
+    }
+    out.insert(out.end(), found.rbegin(), found.rend());
+}
+
+// Sealed segments (suffix ".log") or archives (".arc") of logPath as
+// (sequence number, path), oldest first
+static vector<pair<uint64_t, string>> logSegments(const string& logPath, const string& suffix) {
+    size_t slash = logPath.rfind('/');
+    string dir = slash == string::npos ? "." : logPath.substr(0, slash == 0 ? 1 : slash);
+    string prefix = (slash == string::npos ? logPath : logPath.substr(slash + 1)) + ".";
+    vector<pair<uint64_t, string>> found;
+    if (DIR* d = ::opendir(dir.c_str())) {
+        while (dirent* e = ::readdir(d)) {
+            string_view name(e->d_name);
+            if (name.size() <= prefix.size() + suffix.size() || name.substr(0, prefix.size()) != prefix ||
+                name.substr(name.size() - suffix.size()) != suffix)
+                continue;
+            string_view digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            uint64_t seq;
+            auto r = from_chars(digits.data(), digits.data() + digits.size(), seq);
+            if (r.ec == errc() && r.ptr == digits.data() + digits.size())
+                found.emplace_back(seq, (slash == string::npos ? "" : logPath.substr(0, slash + 1)) + string(name));
+        }
+        ::closedir(d);
+    }
+    sort(found.begin(), found.end());
+    return found;
+}
+
+// Name of sealed segment / archive number seq of logPath
+static string logSegmentPath(const string& logPath, uint64_t seq, const string& suffix) {
+    char num[24];
+    snprintf(num, sizeof num, ".%06llu", (unsigned long long)seq);
+    return logPath + num + suffix;
+}
+
+// Read an account file -- a binary snapshot (accounts.dat) or a legacy
+// name|acc|balance text file -- as a snapshot, e.g. a retained copy of an
+// earlier checkpoint to reconcile from. Its log offset is the one the file
+// records (0 for a text file without a "#checkpoint|" line).
+inline AccountSnapshot readAccountSnapshot(const string& path, unsigned threads = 0) {
+    AccountTable table;
+    uint64_t covered = 0;
+    bool binary;
+    {
+        MappedFile file(path);
+        binary = file.size() >= sizeof accountFileMagic && memcmp(file.data(), accountFileMagic, sizeof accountFileMagic) == 0;
+        if (binary) {
+            table.reserve(file.size() / (sizeof(AccountRecord) + sizeof(NameRef)));
+            covered = decodeAccountFile(file, [&](const AccountRecord& r, string_view name) { table.upsert(r, name); });
+        }
+    }
+    if (!binary) loadLegacyAccountText(path, table, covered, threads);
+    AccountSnapshot snap;
+    table.snapshotTo(snap);
+    snap.setLogOffset(covered);
+    return snap;
+}
+
+// --------------------------- 5k) TRAFFIC TRACE -----------------------------------
+// Binary capture of the operations a manager was asked to run, replayed by
+// the load generator (6d). A header, then one fixed 32-byte record per
+// operation in the order they finished: when (from the start of the
+// capture), what was asked and the status it got. Native byte order, like
+// the account file. A capture that was never closed keeps count 0 in its
+// header; readers then take every whole record in the file.
+static const char trafficTraceMagic[8] = {'B', 'A', 'N', 'K', 'T', 'R', 'C', '\0'};
+static const uint32_t trafficTraceVersion = 1;
+
+enum class TraceOp : uint8_t { Transfer, Deposit, Withdraw };
+constexpr size_t traceOpCount = (size_t)TraceOp::Withdraw + 1;
+
+inline const char* traceOpName(TraceOp op) {
+    switch (op) {
+    case TraceOp::Transfer: return "transfer";
+    case TraceOp::Deposit: return "deposit";
+    case TraceOp::Withdraw: return "withdraw";
+    }
+    return "unknown";
+}
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;                      // records, set when the capture is closed
+    int64_t startedUnixNanos;            // wall clock at the start of the capture
+};
+
+struct TraceRecord {
+    uint64_t atNanos;                    // since the start of the capture
+    int64_t amountMinor;
+    int32_t fromAcc;                     // 0 for a deposit
+    int32_t toAcc;                       // 0 for a withdrawal
+    uint8_t op;                          // TraceOp
+    uint8_t status;                      // TxStatus the operation got
+    uint16_t currency;
+    uint8_t reserved[4];
+
+    TraceOp kind() const { return (TraceOp)op; }
+    Money amount() const { return Money::fromMinor(amountMinor, (Currency)currency); }
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are 32 bytes");
+
+// Appends records from any number of threads. Writing is buffered; a write
+// failure does not disturb the operation being recorded, it is kept and
+// reported by close().
+class TraceWriter {
+private:
+    const string path;
+    int fd = -1;
+    mutex lock;
+    vector<TraceRecord> buffer;
+    uint64_t written = 0;                // records in the file
+    bool failed = false;
+    const chrono::steady_clock::time_point started;
+    static constexpr size_t bufferRecords = 2048;
+
+    void writeBuffer() {
+        if (buffer.empty()) return;
+        if (!failed && !pwriteAll(fd, buffer.data(), buffer.size() * sizeof(TraceRecord),
+                                  sizeof(TraceHeader) + written * sizeof(TraceRecord)))
+            failed = true;
+        if (!failed) written += buffer.size();
+        buffer.clear();
+    }
+
+public:
+    explicit TraceWriter(const string& tracePath) : path(tracePath), started(chrono::steady_clock::now()) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("Unable to create trace file " + path + ".");
+        TraceHeader h{};
+        memcpy(h.magic, trafficTraceMagic, sizeof h.magic);
+        h.version = trafficTraceVersion;
+        h.recordSize = sizeof(TraceRecord);
+        h.startedUnixNanos = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        if (!pwriteAll(fd, &h, sizeof h, 0)) {
+            ::close(fd);
+            throw runtime_error("Unable to write trace file " + path + ".");
+        }
+        buffer.reserve(bufferRecords);
+    }
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    ~TraceWriter() {
+        try {
+            close();
+        } catch (...) {}
+    }
+
+    void record(TraceOp op, int fromAcc, int toAcc, Money amount, TxStatus st) {
+        TraceRecord r{};
+        r.atNanos = nanosSince(started);
+        r.amountMinor = amount.minorUnits();
+        r.fromAcc = fromAcc;
+        r.toAcc = toAcc;
+        r.op = (uint8_t)op;
+        r.status = (uint8_t)st;
+        r.currency = (uint16_t)amount.currency();
+        lock_guard<mutex> lk(lock);
+        if (fd < 0) return;             // closed: late records are dropped
+        buffer.push_back(r);
+        if (buffer.size() >= bufferRecords) writeBuffer();
+    }
+
+    // Write what is buffered and the final count; later records are dropped.
+    // Throws if any part of the trace could not be written.
+    void close() {
+        lock_guard<mutex> lk(lock);
+        if (fd < 0) return;
+        writeBuffer();
+        uint64_t count = written;
+        if (!failed && (!pwriteAll(fd, &count, sizeof count, offsetof(TraceHeader, count)) || ::fdatasync(fd) != 0))
+            failed = true;
+        ::close(fd);
+        fd = -1;
+        if (failed) throw runtime_error("Unable to write trace file " + path + ".");
+    }
+};
+
+// A whole trace, mapped
+class TraceReader {
+private:
+    MappedFile file;
+    TraceHeader header;
+    size_t n = 0;
+
+public:
+    explicit TraceReader(const string& path) : file(path) {
+        if (file.size() < sizeof header) throw runtime_error("Trace file " + path + " is truncated.");
+        memcpy(&header, file.data(), sizeof header);
+        if (memcmp(header.magic, trafficTraceMagic, sizeof header.magic) != 0 ||
+            header.version != trafficTraceVersion || header.recordSize != sizeof(TraceRecord))
+            throw runtime_error(path + " is not a trace file of this version.");
+        size_t whole = (file.size() - sizeof header) / sizeof(TraceRecord);
+        if (header.count > whole) throw runtime_error("Trace file " + path + " is truncated.");
+        n = header.count ? (size_t)header.count : whole;
+    }
+
+    size_t size() const { return n; }
+    int64_t startedUnixNanos() const { return header.startedUnixNanos; }
+
+    TraceRecord operator[](size_t i) const {
+        TraceRecord r;
+        memcpy(&r, file.data() + sizeof header + i * sizeof r, sizeof r);
+        return r;
+    }
+};
+
+// --------------------------- 6) ACCOUNT MANAGER (File handling) ------------------
+// Demonstrates file handling to store & retrieve data (Requirement 8)
+// Accounts are resident: at construction the snapshot in accounts.dat is
+// mapped and the tail of transactions.txt past the snapshot's checkpoint
+// offset is replayed on top of it. From then on every lookup goes through a
+// hash index keyed by account number and every change is a log append;
+// saveAllAccounts writes a new snapshot (checkpoint). compactLog() (or the
+// background compactor) keeps the log itself bounded by sealing and
+// archiving it behind a checkpoint.
+// Thread-safe: transfers lock only the stripes of their two accounts, so
+// transfers between disjoint accounts run in parallel; creating and saving
+// accounts lock all stripes, and listing holds them only while it copies the
+// columns into a snapshot. Single-account reads lock nothing (seqlock).
+struct AccountManagerConfig {
+    string snapshotFile = "accounts.dat";
+    string accountsFile = "accounts.txt";          // legacy text file, converted once
+    string transactionsFile = "transactions.txt";
+    string historyIndexFile = "transactions.idx";  // per-account index over the log, built on demand
+    Durability durability = Durability::Durable;
+    chrono::microseconds groupCommitWindow{200};   // how long a batch waits for company
+    size_t logBufferSize = WriteAheadLog::defaultBufferSize;  // a batch this big is written without waiting
+    unsigned loaderThreads = 0;                    // legacy text parse threads; 0: one per hardware thread
+    vector<int> hotAccounts;                       // split counters from the start (see setHotAccount); must exist
+    unsigned hotAccountParts = 0;                  // sub-balances per hot account; 0: one per hardware thread
+    uint64_t compactLogBytes = 0;                  // compactLog() in the background once the log holds this much; 0: never
+    chrono::milliseconds compactionCheckInterval{1000};  // how often the background compactor looks
+};
+
+// What one compactLog() call did
+struct CompactionStats {
+    uint64_t logBytesSealed = 0;        // active log moved out of transactions.txt (0: it was empty)
+    size_t segmentsArchived = 0;        // sealed segments turned into archives, leftovers included
+    uint64_t recordsArchived = 0;
+    uint64_t archiveBytes = 0;
+};
+
+class AccountManager {
+private:
+    const string snapshotFile;
+    const string accountsFile;
+    const string transactionsFile;
+    const string historyIndexFile;
+    AccountTable table;                    // resident account store, indexed by accNumber
+    LockStripes stripes;                   // per-account locks; all of them guard the layout
+    unique_ptr<WriteAheadLog> wal;
+    const unsigned loaderThreads;
+    LoadStats stats;                       // what the constructor's load found
+    size_t snapshotRows = 0;               // table slots laid out row for row in snapshotFile
+    uint64_t sealedSegments = 0;           // sealed log segments; transactionsFile is number sealedSegments + 1
+    mutex historyLock;
+    unique_ptr<TransactionHistory> history; // opened by the first history query
+    Metrics metrics;
+    atomic<const HotSet*> hotSet{nullptr};
+    vector<unique_ptr<HotSet>> hotSets;            // every set ever published
+    vector<unique_ptr<HotBalance>> hotBalances;    // every split counter ever created
+    const unsigned hotAccountParts;
+    mutex compactionLock;                  // one compactLog() at a time
+    mutex compactorMutex;
+    condition_variable compactorWake;
+    bool compactorStopping = false;
+    string compactionFailure;              // what the last background compaction threw
+    thread compactor;
+    mutex captureLock;                     // one startCapture()/stopCapture() at a time
+    atomic<TraceWriter*> capture{nullptr};
+    vector<unique_ptr<TraceWriter>> traces; // every capture ever started, like hotSets
+
+    static constexpr const char* openNote = "open:";
+    static constexpr const char* productNote = "product:";
+    static constexpr const char* depositNote = "deposit";        // 0|acc|amount: paid in
+    static constexpr const char* withdrawalNote = "withdrawal";  // acc|0|amount: paid out
+    static constexpr const char* interestNote = "interest";      // either form: accrued (accrueInterest)
+
+    // Map the snapshot (converting a legacy text file on first use); returns
+    // the log offset it is consistent with, and in segment the sealed
+    // segments that offset comes after
+    uint64_t loadSnapshot(uint64_t& segment) {
+        segment = 0;
+        table.clear();
+        recoverAccountFile(snapshotFile);
+        if (!fileExists(snapshotFile)) {
+            if (!fileExists(accountsFile)) return 0; // no snapshot yet: the whole log is replayed
+            stats.accountLinesSkipped =
+                convertLegacyAccountFile(accountsFile, snapshotFile, transactionsFile, loaderThreads).accountLinesSkipped;
+        }
+        MappedFile file(snapshotFile);
+        table.reserve(file.size() / (sizeof(AccountRecord) + sizeof(NameRef)));
+        uint64_t covered = decodeAccountFile(file, [this](const AccountRecord& r, string_view name) {
+            table.upsert(r, name);
+            ++stats.accountsLoaded;
+        });
+        AccountFileHeader h;
+        memcpy(&h, file.data(), sizeof h);
+        // a file with duplicate rows is rewritten whole at the next checkpoint
+        snapshotRows = h.count == table.size() ? table.size() : 0;
+        segment = h.logSegment;
+        table.markClean();
+        return covered;
+    }
+
+    // Bring snapshotFile up to date with the table as of log offset covered:
+    // only the changed records when the account set is unchanged, otherwise a
+    // full rewrite. Caller holds all stripes.
+    void writeCheckpoint(uint64_t covered) {
+        auto t0 = chrono::steady_clock::now();
+        foldHotAccounts();
+        recoverAccountFile(snapshotFile);
+        vector<uint32_t> slots;
+        bool patch = snapshotRows == table.size() && !table.layoutChanged() && fileExists(snapshotFile);
+        if (patch) {
+            table.dirtySlots(slots);
+            patch = slots.size() <= table.size() / 2;   // past that, journal + patch outweigh a rewrite
+        }
+        if (patch) {
+            patchAccountFile(snapshotFile, table, slots, covered, sealedSegments);
+        } else {
+            writeFileAtomically(snapshotFile, encodeAccountFile(table, covered, sealedSegments));
+            snapshotRows = table.size();
+        }
+        table.markClean();
+        metrics.local().save.record(nanosSince(t0));
+    }
+
+    // Apply the log from offset onward; a torn final record is cut off
+    void replayLog(uint64_t offset) {
+        if (!fileExists(transactionsFile)) return;
+        uint64_t validEnd;
+        {
+            TransactionLogReader reader(transactionsFile, offset);
+            Transaction tx;
+            uint64_t at;
+            while (reader.next(tx, at)) {
+                applyLogged(tx);
+                ++stats.logRecordsApplied;
+            }
+            stats.logLinesSkipped += reader.skipped();
+            validEnd = max(reader.position(), offset);
+        }
+        if (validEnd < fileSize(transactionsFile) && ::truncate(transactionsFile.c_str(), (off_t)validEnd) != 0)
+            throw runtime_error("Unable to repair transaction file.");
+    }
+
+    // Redo one logged record without re-validating it
+    void applyLogged(const Transaction& tx) {
+        const string& note = tx.getNote();
+        if (tx.getFromAcc() == 0 && note.compare(0, strlen(openNote), openNote) == 0) {
+            table.upsert(tx.getToAcc(), string_view(note).substr(strlen(openNote)), tx.getAmount());
+            return;
+        }
+        if (tx.getFromAcc() == 0 && note.compare(0, strlen(productNote), productNote) == 0) {
+            size_t slot = table.find(tx.getToAcc());
+            if (slot != AccountTable::npos) table.setProduct(slot, (uint16_t)stoi(note.substr(strlen(productNote))));
+            return;
+        }
+        int64_t amt = tx.getAmount().minorUnits();
+        // account 0 stands for the outside world in a deposit or withdrawal
+        bool external = (tx.getFromAcc() == 0 && (note == depositNote || note == interestNote)) ||
+                        (tx.getToAcc() == 0 && (note == withdrawalNote || note == interestNote));
+        size_t src = external && tx.getFromAcc() == 0 ? AccountTable::npos : table.find(tx.getFromAcc());
+        size_t dst = external && tx.getToAcc() == 0 ? AccountTable::npos : table.find(tx.getToAcc());
+        if (src != AccountTable::npos) table.balanceMinor(src) -= amt;
+        if (dst != AccountTable::npos) table.balanceMinor(dst) += amt;
+    }
+
+    // Background compactor: compactLog() whenever the active log has grown
+    // past threshold, looking every interval until the destructor stops it
+    void runCompactor(uint64_t threshold, chrono::milliseconds interval) {
+        unique_lock<mutex> lk(compactorMutex);
+        while (!compactorWake.wait_for(lk, interval, [this] { return compactorStopping; })) {
+            lk.unlock();
+            string failure;
+            try {
+                if (wal->appended() >= threshold) compactLog();
+            } catch (const exception& e) {
+                failure = e.what();
+            }
+            lk.lock();
+            if (!failure.empty()) compactionFailure = failure;
+        }
+    }
+
+    // recentTransactions over sealed segment seq: its archive, or its text
+    // while compactLog() has not archived it yet. The archive is written
+    // before the text is removed, so one of the two is always there.
+    void recentInSegment(uint64_t seq, int accNo, size_t n, vector<Transaction>& out) {
+        string archive = logSegmentPath(transactionsFile, seq, ".arc");
+        if (!fileExists(archive)) {
+            int fd = ::open(logSegmentPath(transactionsFile, seq, ".log").c_str(), O_RDONLY);
+            if (fd >= 0) {
+                try {
+                    recentInLogText(fd, accNo, n, out);
+                } catch (...) {
+                    ::close(fd);
+                    throw;
+                }
+                ::close(fd);
+                return;
+            }
+            if (!fileExists(archive)) return;   // no such segment
+        }
+        LogArchive(archive).recentFor(accNo, n, out);
+    }
+
+    // Log records; started is when the append began, for waitLogged
+    uint64_t appendLog(string_view records, chrono::steady_clock::time_point& started) {
+        started = chrono::steady_clock::now();
+        uint64_t ticket = wal->append(records);
+        metrics.local().logBytes.fetch_add(records.size(), memory_order_relaxed);
+        return ticket;
+    }
+
+    // Wait until ticket is durable; records the append-to-durable latency
+    void waitLogged(uint64_t ticket, chrono::steady_clock::time_point started) {
+        wal->waitDurable(ticket);
+        metrics.local().logAppend.record(nanosSince(started));
+    }
+
+    void traceOp(TraceOp op, int fromAcc, int toAcc, Money amount, TxStatus st) {
+        if (TraceWriter* t = capture.load(memory_order_acquire)) t->record(op, fromAcc, toAcc, amount, st);
+    }
+
+    void countTransfer(TxStatus st) {
+        MetricCell& c = metrics.local();
+        if (st == TxStatus::Ok) c.transfersApplied.fetch_add(1, memory_order_relaxed);
+        else c.transfersRejected[(size_t)st].fetch_add(1, memory_order_relaxed);
+    }
+
+    // Move every hot account's parts into its row. Caller holds all stripes.
+    void foldHotAccounts() {
+        for (HotBalance* h : hotSet.load(memory_order_relaxed)->accounts) {
+            size_t slot = table.find(h->accNumber());
+            if (slot == AccountTable::npos) continue;
+            if (int64_t parts = h->drain()) table.balanceMinor(slot) += parts;
+        }
+    }
+
+    // Balance of slot including the parts of a hot account (for readers)
+    int64_t balanceWithParts(size_t slot) const {
+        const HotBalance* h = hotSet.load(memory_order_acquire)->find(table.accNumber(slot));
+        return table.row(slot).balance + (h ? h->pending() : 0);
+    }
+
+    // Applies and logs a transfer without waiting for the log: on Ok, the
+    // caller waits for `ticket` outside the locks, so concurrent transfers
+    // share one fsync.
+    TxStatus applyTransfer(int fromAcc, int toAcc, Money amount, uint64_t& ticket,
+                           chrono::steady_clock::time_point& started) {
+        if (!amount.isPositive()) return TxStatus::InvalidAmount;
+        TxStatus st;
+        // the hot set is re-checked under the stripes; retry if it changed meanwhile
+        while (!attemptTransfer(hotSet.load(memory_order_acquire), fromAcc, toAcc, amount, st, ticket, started)) {}
+        return st;
+    }
+
+    // One transfer attempt against the hot set `hot`. Returns false, having
+    // changed nothing, when that set was replaced before the locks were held.
+    bool attemptTransfer(const HotSet* hot, int fromAcc, int toAcc, Money amount, TxStatus& st, uint64_t& ticket,
+                         chrono::steady_clock::time_point& started) {
+        HotBalance* hotSrc = hot->find(fromAcc);
+        HotBalance* hotDst = hot->find(toAcc);
+        int64_t amt = amount.minorUnits();
+        thread_local string record;       // reused: formatting the record allocates nothing
+        record.clear();
+        Transaction(fromAcc, toAcc, amount, "transfer").appendRecord(record);
+        size_t src, dst;
+        auto resolve = [&] {
+            src = table.find(fromAcc);
+            dst = table.find(toAcc);
+            if (src == AccountTable::npos || dst == AccountTable::npos) st = TxStatus::AccountNotFound;
+            else if (table.currency(src) != amount.currency() || table.currency(dst) != amount.currency())
+                st = TxStatus::CurrencyMismatch;
+            else st = TxStatus::Ok;
+            return st == TxStatus::Ok;
+        };
+        auto creditDst = [&] {
+            if (hotDst) hotDst->credit(amt);
+            else table.balanceMinor(dst) += amt;
+        };
+
+        if (hotSrc) {
+            // Out of a hot account: holding the destination's stripe pins the hot set
+            PairLock lk(stripes, toAcc, toAcc);
+            if (hotSet.load(memory_order_relaxed) != hot) return false;
+            if (!resolve()) return true;
+            if (hotSrc->tryReserve(amt)) {
+                try {
+                    ticket = appendLog(record, started);
+                } catch (...) {
+                    hotSrc->credit(amt);
+                    throw;
+                }
+                creditDst();
+                return true;
+            }
+        }
+        // A hot destination is credited in its parts, so only the source's stripe is needed
+        PairLock lk(stripes, fromAcc, hotDst ? fromAcc : toAcc);
+        if (hotSet.load(memory_order_relaxed) != hot) return false;
+        if (!resolve()) return true;
+        if (hotSrc) {
+            if (int64_t parts = hotSrc->drain()) table.balanceMinor(src) += parts;
+        }
+        if (table.balanceMinor(src) < amt) {
+            st = TxStatus::InsufficientFunds;
+            return true;
+        }
+
+        // Log first: if the log is broken, balances stay untouched
+        ticket = appendLog(record, started);
+
+        table.balanceMinor(src) -= amt;
+        creditDst();
+        return true;
+    }
+
+    // Pay amount into (deposit) or out of accNo from outside the bank,
+    // logged as 0|accNo|amount|deposit or accNo|0|amount|withdrawal. Like
+    // applyTransfer, the caller waits for `ticket` on Ok.
+    TxStatus applyExternal(int accNo, bool deposit, Money amount, uint64_t& ticket,
+                           chrono::steady_clock::time_point& started) {
+        if (!amount.isPositive()) return TxStatus::InvalidAmount;
+        int64_t amt = amount.minorUnits();
+        thread_local string record;
+        record.clear();
+        Transaction(deposit ? 0 : accNo, deposit ? accNo : 0, amount, deposit ? depositNote : withdrawalNote)
+            .appendRecord(record);
+        for (;;) {
+            const HotSet* hot = hotSet.load(memory_order_acquire);
+            PairLock lk(stripes, accNo, accNo);
+            if (hotSet.load(memory_order_relaxed) != hot) continue;
+            size_t slot = table.find(accNo);
+            if (slot == AccountTable::npos) return TxStatus::AccountNotFound;
+            if (table.currency(slot) != amount.currency()) return TxStatus::CurrencyMismatch;
+            HotBalance* h = hot->find(accNo);
+            if (!deposit) {
+                if (h) {
+                    if (int64_t parts = h->drain()) table.balanceMinor(slot) += parts;
+                }
+                if (table.balanceMinor(slot) < amt) return TxStatus::InsufficientFunds;
+            }
+            ticket = appendLog(record, started);
+            table.balanceMinor(slot) += deposit ? amt : -amt;
+            return TxStatus::Ok;
+        }
+    }
+
+    Result<void> tryExternal(int accNo, bool deposit, Money amount) {
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        TxStatus st = applyExternal(accNo, deposit, amount, ticket, started);
+        if (st == TxStatus::Ok) waitLogged(ticket, started);
+        traceOp(deposit ? TraceOp::Deposit : TraceOp::Withdraw, deposit ? 0 : accNo, deposit ? accNo : 0, amount, st);
+        return st;
+    }
+
+public:
+    explicit AccountManager(const AccountManagerConfig& cfg = AccountManagerConfig())
+        : snapshotFile(cfg.snapshotFile), accountsFile(cfg.accountsFile), transactionsFile(cfg.transactionsFile),
+          historyIndexFile(cfg.historyIndexFile), loaderThreads(cfg.loaderThreads),
+          hotAccountParts(cfg.hotAccountParts ? cfg.hotAccountParts : max(1u, thread::hardware_concurrency())) {
+        hotSets.emplace_back(new HotSet);
+        hotSet.store(hotSets.back().get());
+        auto t0 = chrono::steady_clock::now();
+        uint64_t segment;
+        uint64_t covered = loadSnapshot(segment);
+        for (const char* suffix : {".log", ".arc"})
+            for (auto& seg : logSegments(transactionsFile, suffix)) sealedSegments = max(sealedSegments, seg.first);
+        // one segment behind: compactLog() sealed the log the snapshot covers
+        // up to its end before it could checkpoint again
+        bool sealed = segment + 1 == sealedSegments && fileExists(snapshotFile);
+        if (segment != sealedSegments && !sealed)
+            throw runtime_error("Account snapshot " + snapshotFile + " does not match the sealed log segments.");
+        if (!sealed && covered > fileSize(transactionsFile))
+            throw runtime_error("Transaction log " + transactionsFile + " is shorter than the snapshot covers.");
+        replayLog(sealed ? 0 : covered);
+        if (sealed) writeCheckpoint(0);
+        wal.reset(new WriteAheadLog(transactionsFile, cfg.durability, cfg.groupCommitWindow, cfg.logBufferSize));
+        metrics.local().load.record(nanosSince(t0));
+        for (int acc : cfg.hotAccounts) setHotAccount(acc, true);
+        if (cfg.compactLogBytes > 0)
+            compactor = thread(&AccountManager::runCompactor, this, cfg.compactLogBytes, cfg.compactionCheckInterval);
+    }
+
+    ~AccountManager() {
+        try {
+            stopCapture();
+        } catch (...) {}
+        if (!compactor.joinable()) return;
+        {
+            lock_guard<mutex> lk(compactorMutex);
+            compactorStopping = true;
+        }
+        compactorWake.notify_one();
+        compactor.join();
+    }
+
+    // What loading the snapshot and replaying the log found, skipped lines included
+    const LoadStats& loadStats() const { return stats; }
+
+    // Create an account; it is persisted as an opening entry in the log
+    void createAccount(const BankAccount& acc) {
+        Transaction open(0, acc.getAccNumber(), acc.getBalanceConstRef(), openNote + acc.getName());
+        uint64_t ticket;
+        chrono::steady_clock::time_point started;
+        {
+            AllStripesLock lk(stripes);
+            ticket = appendLog(open.toRecord(), started);
+            foldHotAccounts();      // an existing account's balance is replaced whole
+            table.upsert(acc.getAccNumber(), acc.getName(), acc.getBalanceConstRef());
+        }
+        waitLogged(ticket, started);
+    }
+
+    // Create many accounts with one log append and one lock acquisition.
+    // Accounts whose number already exists -- in the store or earlier in the
+    // batch, where the first occurrence wins -- are not created; their
+    // numbers are returned, in batch order. Unlike createAccount this never
+    // overwrites an existing account.
+    vector<int> createAccounts(const BankAccount* accounts, size_t n) {
+        vector<int> rejected;
+        if (n == 0) return rejected;
+
+        // Duplicates within the batch: one probe per account into a scratch index
+        vector<uint8_t> keep(n, 1);
+        {
+            AccountIndex seen;
+            seen.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                int acc = accounts[i].getAccNumber();
+                if (seen.find(acc) != AccountIndex::missing) keep[i] = 0;
+                else seen.insert(acc, (uint32_t)i);
+            }
+        }
+
+        // Format every candidate's opening entry outside the lock
+        string records;
+        vector<size_t> ends(n);
+        records.reserve(n * 48);
+        for (size_t i = 0; i < n; ++i) {
+            if (keep[i]) {
+                const BankAccount& a = accounts[i];
+                Transaction(0, a.getAccNumber(), a.getBalanceConstRef(), openNote + a.getName()).appendRecord(records);
+            }
+            ends[i] = records.size();
+        }
+
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        {
+            AllStripesLock lk(stripes);
+            // Duplicates of stored accounts; drop their entries only if there are any
+            size_t againstStore = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (keep[i] && table.find(accounts[i].getAccNumber()) != AccountTable::npos) {
+                    keep[i] = 0;
+                    ++againstStore;
+                }
+            }
+            if (againstStore > 0) {
+                string filtered;
+                filtered.reserve(records.size());
+                for (size_t i = 0; i < n; ++i) {
+                    size_t begin = i ? ends[i - 1] : 0;
+                    if (keep[i]) filtered.append(records, begin, ends[i] - begin);
+                }
+                records.swap(filtered);
+            }
+            if (!records.empty()) {
+                ticket = appendLog(records, started);
+                size_t accepted = (size_t)count(keep.begin(), keep.end(), 1);
+                table.reserve(table.size() + accepted);
+                table.reserveNames(table.size() + accepted);
+                for (size_t i = 0; i < n; ++i) {
+                    const BankAccount& a = accounts[i];
+                    if (keep[i]) table.upsert(a.getAccNumber(), a.getName(), a.getBalanceConstRef());
+                }
+            }
+        }
+        for (size_t i = 0; i < n; ++i)
+            if (!keep[i]) rejected.push_back(accounts[i].getAccNumber());
+        if (!records.empty()) waitLogged(ticket, started);
+        return rejected;
+    }
+
+    vector<int> createAccounts(const vector<BankAccount>& accounts) {
+        return createAccounts(accounts.data(), accounts.size());
+    }
+
+    // Copy of all resident accounts as of one instant (the file is not
+    // re-read). The accounts are built from a snapshot, so transfers wait
+    // only for the column copy.
+    vector<BankAccount> loadAllAccounts() {
+        auto t0 = chrono::steady_clock::now();
+        AccountSnapshot snap = snapshot();
+        vector<BankAccount> list;
+        list.reserve(snap.size());
+        for (size_t i = 0; i < snap.size(); ++i) list.push_back(snap.materialize(i));
+        metrics.local().load.record(nanosSince(t0));
+        return list;
+    }
+
+    // Consistent point-in-time view of every account, with the log offset it
+    // matches. Transfers and reads pause while the columns are copied; the
+    // snapshot is then read without any lock.
+    AccountSnapshot snapshot() {
+        AccountSnapshot snap;
+        AllStripesLock lk(stripes);
+        foldHotAccounts();
+        table.snapshotTo(snap);
+        snap.setLogOffset(wal->appended());
+        return snap;
+    }
+
+    // End-of-day export: a snapshot written in the legacy text format
+    // (name|acc|balance lines), atomically replacing path. Returns the log
+    // offset the export is consistent with.
+    uint64_t exportAccounts(const string& path) {
+        AccountSnapshot snap = snapshot();
+        writeFileAtomically(path, snap.toText());
+        return snap.logOffset();
+    }
+
+    // Make list the resident set and checkpoint it as a snapshot of the whole
+    // log. When list holds the same accounts as the resident set, only the
+    // records that differ from it are written.
+    void saveAllAccounts(const vector<BankAccount>& list) {
+        AllStripesLock lk(stripes);
+        uint64_t covered = wal->flush();
+        foldHotAccounts();
+        bool sameAccounts = list.size() == table.size();
+        vector<uint8_t> seen(sameAccounts ? table.size() : 0);
+        for (size_t i = 0; sameAccounts && i < list.size(); ++i) {
+            size_t slot = table.find(list[i].getAccNumber());
+            sameAccounts = slot != AccountTable::npos && !seen[slot];
+            if (sameAccounts) seen[slot] = 1;
+        }
+        if (sameAccounts) {
+            for (const auto& a : list) table.upsert(a.getAccNumber(), a.getName(), a.getBalanceConstRef());
+        } else {
+            vector<AccountRecord> rows;             // product codes survive the rebuild
+            rows.reserve(list.size());
+            for (const auto& a : list) {
+                AccountRecord r = a.record();
+                size_t slot = table.find(a.getAccNumber());
+                if (slot != AccountTable::npos) r.product = table.product(slot);
+                rows.push_back(r);
+            }
+            table.clear();
+            table.reserve(list.size());
+            for (size_t i = 0; i < list.size(); ++i) table.upsert(rows[i], list[i].getName());
+        }
+        writeCheckpoint(covered);
+    }
+
+    // Assign the interest product (rate table entry) of an account; logged
+    Result<void> setProduct(int accNo, uint16_t product) {
+        uint64_t ticket;
+        chrono::steady_clock::time_point started;
+        {
+            PairLock lk(stripes, accNo, accNo);
+            size_t slot = table.find(accNo);
+            if (slot == AccountTable::npos) return TxStatus::AccountNotFound;
+            Transaction tx(0, accNo, Money(), productNote + to_string(product));
+            ticket = appendLog(tx.toRecord(), started);
+            table.setProduct(slot, product);
+        }
+        waitLogged(ticket, started);
+        return TxStatus::Ok;
+    }
+
+    // Designate accNo a hot account (or undo that): transfers into it stop
+    // contending for its stripe, and its balance is kept as a split counter
+    // of `parts` sub-balances (0: the configured count). The designation is
+    // not persisted; list standing hot accounts in the config.
+    Result<void> setHotAccount(int accNo, bool hot, unsigned parts = 0) {
+        AllStripesLock lk(stripes);
+        if (table.find(accNo) == AccountTable::npos) return TxStatus::AccountNotFound;
+        foldHotAccounts();
+        const HotSet* current = hotSet.load(memory_order_relaxed);
+        if ((current->find(accNo) != nullptr) == hot) return TxStatus::Ok;
+        unique_ptr<HotSet> next(new HotSet);
+        for (HotBalance* h : current->accounts)
+            if (h->accNumber() != accNo) next->accounts.push_back(h);
+        if (hot) {
+            hotBalances.emplace_back(new HotBalance(accNo, parts ? parts : hotAccountParts));
+            next->accounts.push_back(hotBalances.back().get());
+        }
+        hotSet.store(next.get(), memory_order_release);
+        hotSets.push_back(std::move(next));
+        return TxStatus::Ok;
+    }
+
+    // Fold the parts of every hot account into its row, a stripe at a time;
+    // checkpoints and snapshots do this themselves
+    void rebalanceHotAccounts() {
+        for (;;) {
+            const HotSet* hot = hotSet.load(memory_order_acquire);
+            bool changed = false;
+            for (HotBalance* h : hot->accounts) {
+                PairLock lk(stripes, h->accNumber(), h->accNumber());
+                if ((changed = hotSet.load(memory_order_relaxed) != hot)) break;
+                size_t slot = table.find(h->accNumber());
+                int64_t parts = slot == AccountTable::npos ? 0 : h->drain();
+                if (parts) table.balanceMinor(slot) += parts;
+            }
+            if (!changed) return;
+        }
+    }
+
+    // Credit one period of interest to every account with a positive balance
+    // at its product's rate, on `threads` threads (0: one per hardware
+    // thread) over slot ranges. Every credit is logged, as 0|acc|amount|interest
+    // (acc|0|amount|interest for a negative rate), in one append before any
+    // balance changes, so replay and reconcile see it like a deposit.
+    // Returns the number of accounts credited.
+    size_t accrueInterest(const InterestPlan& plan, unsigned threads = 0) {
+        vector<double> factors = interestFactors(plan);
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        string records;
+        size_t credited = 0;
+        {
+            AllStripesLock lk(stripes);
+            foldHotAccounts();
+            size_t n = table.size();
+            vector<int64_t> interest(n);
+            const int64_t* balances = table.balanceColumn();
+            const uint16_t* products = table.productColumn();
+            uint32_t last = (uint32_t)factors.size() - 1;
+            const size_t minRange = 1 << 16;
+            size_t ranges = threads == 0 ? max(1u, thread::hardware_concurrency()) : threads;
+            ranges = max<size_t>(1, min(ranges, n / minRange));
+            if (ranges == 1) {
+                kernels::accrue(balances, products, factors.data(), last, n, interest.data());
+            } else {
+                ThreadPool pool((unsigned)ranges);
+                vector<future<void>> done;
+                for (size_t r = 0; r < ranges; ++r) {
+                    size_t lo = n * r / ranges, hi = n * (r + 1) / ranges;
+                    done.push_back(pool.submit([&, lo, hi] {
+                        kernels::accrue(balances + lo, products + lo, factors.data(), last, hi - lo, interest.data() + lo);
+                    }));
+                }
+                for (auto& d : done) d.get();
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                int64_t v = interest[i];
+                if (v == 0) continue;
+                int acc = table.accNumber(i);
+                Transaction(v > 0 ? 0 : acc, v > 0 ? acc : 0, Money::fromMinor(v > 0 ? v : -v, table.currency(i)), interestNote)
+                    .appendRecord(records);
+                ++credited;
+            }
+            if (records.empty()) return 0;
+            ticket = appendLog(records, started);
+            table.addToBalances(interest.data());
+        }
+        waitLogged(ticket, started);
+        return credited;
+    }
+
+    // Write the changes made since the last checkpoint into the snapshot, so
+    // the next start replays less log; returns the log offset now covered
+    uint64_t checkpoint() {
+        AllStripesLock lk(stripes);
+        uint64_t covered = wal->flush();
+        writeCheckpoint(covered);
+        return covered;
+    }
+
+    // Make everything logged so far durable (a no-op cost in Durable mode)
+    void flush() { wal->flush(); }
+
+    // Bound the log: checkpoint, seal the active segment as
+    // transactions.txt.<seq>.log and continue in an empty transactions.txt,
+    // then turn every sealed segment into an archive (section 5j) and delete
+    // its text. The history index is dropped with the segment it indexed. Transfers wait only for the checkpoint and the file switch;
+    // archiving runs beside them. A restart then replays only what was logged
+    // since, and recentTransactions reads the sealed segments (the archives,
+    // or the text of one not archived yet) for older records.
+    // Snapshots taken before a compaction are no reconcile() baselines
+    // afterwards: the compaction's checkpoint is the new baseline.
+    CompactionStats compactLog() {
+        lock_guard<mutex> one(compactionLock);
+        CompactionStats st;
+        {
+            AllStripesLock lk(stripes);
+            uint64_t end = wal->flush();
+            if (end > 0) {
+                uint64_t seq = sealedSegments + 1;
+                writeCheckpoint(end);               // the snapshot alone now stands for the segment
+                wal->seal(transactionsFile, logSegmentPath(transactionsFile, seq, ".log"));
+                sealedSegments = seq;
+                try {
+                    writeCheckpoint(0);
+                } catch (...) {
+                    // the snapshot still names the sealed segment, which a
+                    // restart repairs; take no more records until then
+                    wal->fail();
+                    throw;
+                }
+                // the index points into the sealed segment: the next query rebuilds it over the new log
+                lock_guard<mutex> h(historyLock);
+                history.reset();
+                if (::unlink(historyIndexFile.c_str()) != 0 && errno != ENOENT)
+                    throw runtime_error("Unable to remove transaction index " + historyIndexFile + ".");
+                st.logBytesSealed = end;
+            }
+        }
+        for (auto& [seq, sealed] : logSegments(transactionsFile, ".log")) {
+            LogArchiveInfo info = writeLogArchive(sealed, fileSize(sealed), logSegmentPath(transactionsFile, seq, ".arc"));
+            if (::unlink(sealed.c_str()) != 0) throw runtime_error("Unable to remove sealed log " + sealed + ".");
+            ++st.segmentsArchived;
+            st.recordsArchived += info.records;
+            st.archiveBytes += info.bytes;
+        }
+        return st;
+    }
+
+    // Message of the last failed background compaction ("" if none failed)
+    string lastCompactionFailure() {
+        lock_guard<mutex> lk(compactorMutex);
+        return compactionFailure;
+    }
+
+    // Verify the log against the resident accounts: replaying it from
+    // baseline's log offset onto baseline must give the accounts as they are
+    // now (see reconcileLedger). Transfers keep running meanwhile; the check
+    // is against a snapshot taken at the start.
+    ReconcileReport reconcile(const AccountSnapshot& baseline, const ReconcileConfig& cfg = {}) {
+        AccountSnapshot now = snapshot();
+        wal->flush();                       // the range up to now must be in the file
+        return reconcileLedger(baseline, transactionsFile, now, cfg);
+    }
+
+    // Counters and latency histograms since construction. Lock-free: safe to
+    // call from a monitoring thread while transfers run.
+    MetricsSnapshot metricsSnapshot() const {
+        MetricsSnapshot s;
+        metrics.snapshot(s);
+        s.accountLinesSkipped = stats.accountLinesSkipped;
+        s.logLinesSkipped = stats.logLinesSkipped;
+        return s;
+    }
+
+    // O(1) lookup in the resident store; returns a copy of the account.
+    // Lock-free: never waits for a transfer.
+    Result<BankAccount> getAccount(int accNo) {
+        AccountTable::Lookup at;
+        return stripes.read(accNo, [&]() -> Result<BankAccount> {
+            at = table.lookup(accNo);
+            if (at.slot == AccountTable::npos) return TxStatus::AccountNotFound;
+            AccountRecord r = table.row(at.slot);
+            r.balance = balanceWithParts(at.slot);
+            return BankAccount(r, table.name(at.slot));
+        }, [&] { table.settle(at); });
+    }
+
+    // ----------------- Analytics scans over the balance column ------------------
+    // All balances are assumed to share one currency; the results carry the
+    // default currency tag.
+    struct BalanceStats {
+        size_t count = 0;
+        Money total, lowest, highest;
+    };
+
+    BalanceStats balanceStats() {
+        AllStripesLock lk(stripes);
+        foldHotAccounts();
+        BalanceStats st;
+        st.count = table.size();
+        if (st.count == 0) return st;
+        const int64_t* col = table.balanceColumn();
+        st.total = Money::fromMinor(kernels::sum(col, st.count));
+        st.lowest = Money::fromMinor(kernels::minimum(col, st.count));
+        st.highest = Money::fromMinor(kernels::maximum(col, st.count));
+        return st;
+    }
+
+    // Account numbers of every account whose balance is below threshold
+    // (accountsBelow(Money()) lists overdrawn accounts)
+    vector<int> accountsBelow(Money threshold) {
+        AllStripesLock lk(stripes);
+        foldHotAccounts();
+        vector<uint32_t> slots;
+        kernels::filterBelow(table.balanceColumn(), table.size(), threshold.minorUnits(), slots);
+        vector<int> result;
+        result.reserve(slots.size());
+        for (uint32_t slot : slots) result.push_back(table.accNumber(slot));
+        return result;
+    }
+
+    // Find account index by account number
+    int findAccountIndex(vector<BankAccount>& list, int accNo) {
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (list[i].getAccNumber() == accNo) return (int)i;
+        }
+        return -1;
+    }
+
+    // Non-throwing transfer: the status says why a transfer was refused.
+    // Throws only if the transaction log cannot be written.
+    Result<void> tryTransfer(int fromAcc, int toAcc, Money amount) {
+        auto t0 = chrono::steady_clock::now();
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        TxStatus st = applyTransfer(fromAcc, toAcc, amount, ticket, started);
+        if (st == TxStatus::Ok) waitLogged(ticket, started);
+        metrics.local().transfer.record(nanosSince(t0));
+        countTransfer(st);
+        traceOp(TraceOp::Transfer, fromAcc, toAcc, amount, st);
+        return st;
+    }
+
+    // Callback form of tryTransfer that never blocks on the log: the transfer
+    // is applied and logged at once and the status returned; on Ok,
+    // onDurable(true) runs when its log record is durable (on the log's
+    // committer thread in Durable mode, so it must be short), or
+    // onDurable(false) if the log failed first. Refused transfers never call
+    // onDurable. Rejections and balances are exactly those of tryTransfer.
+    Result<void> submitTransfer(int fromAcc, int toAcc, Money amount, function<void(bool durable)> onDurable) {
+        auto t0 = chrono::steady_clock::now();
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        TxStatus st = applyTransfer(fromAcc, toAcc, amount, ticket, started);
+        countTransfer(st);
+        traceOp(TraceOp::Transfer, fromAcc, toAcc, amount, st);
+        if (st != TxStatus::Ok) {
+            metrics.local().transfer.record(nanosSince(t0));
+            return st;
+        }
+        wal->whenDurable(ticket, [this, t0, started, done = std::move(onDurable)](bool durable) {
+            MetricCell& c = metrics.local();
+            c.logAppend.record(nanosSince(started));
+            c.transfer.record(nanosSince(t0));
+            if (done) done(durable);
+        });
+        return TxStatus::Ok;
+    }
+
+    // Money paid in from or out to outside the bank (cash, a wire). Statuses
+    // as for tryTransfer; a deposit is never InsufficientFunds. Throws only
+    // if the transaction log cannot be written.
+    Result<void> tryDeposit(int accNo, Money amount) { return tryExternal(accNo, true, amount); }
+    Result<void> tryWithdraw(int accNo, Money amount) { return tryExternal(accNo, false, amount); }
+
+    // Record every transfer, deposit and withdrawal requested from now on --
+    // with the status it got -- to a binary trace at path (see 5k), for
+    // replayTrace to run again. Replaces a capture already running.
+    void startCapture(const string& path) {
+        lock_guard<mutex> lk(captureLock);
+        traces.emplace_back(new TraceWriter(path));
+        TraceWriter* previous = capture.exchange(traces.back().get(), memory_order_acq_rel);
+        if (previous) previous->close();
+    }
+
+    // End the capture and complete its file; throws if it could not be written.
+    // The writer stays alive: an operation still recording into it is dropped.
+    void stopCapture() {
+        lock_guard<mutex> lk(captureLock);
+        if (TraceWriter* t = capture.exchange(nullptr, memory_order_acq_rel)) t->close();
+    }
+
+    // Transfer funds (shows objects passed & returned and exception handling)
+    bool transferFunds(int fromAcc, int toAcc, Money amount) {
+        return raiseTransferStatus(tryTransfer(fromAcc, toAcc, amount).status());
+    }
+
+    // transferFunds' mapping of a refused transfer onto the exception it throws
+    static bool raiseTransferStatus(TxStatus st) {
+        switch (st) {
+        case TxStatus::Ok: return true;
+        case TxStatus::InvalidAmount: throw invalid_argument("Transfer amount must be positive.");
+        case TxStatus::AccountNotFound: throw runtime_error("Source or destination account not found.");
+        case TxStatus::InsufficientFunds: throw runtime_error("Insufficient funds in source account.");
+        case TxStatus::CurrencyMismatch: throw invalid_argument("Currency mismatch.");
+        case TxStatus::QueueFull: throw runtime_error("Transfer queue is full.");
+        }
+        return false;
+    }
+
+    // Current balance of one account; lock-free like getAccount
+    Result<Money> balanceOf(int accNo) {
+        AccountTable::Lookup at;
+        return stripes.read(accNo, [&]() -> Result<Money> {
+            at = table.lookup(accNo);
+            if (at.slot == AccountTable::npos) return TxStatus::AccountNotFound;
+            return Money::fromMinor(balanceWithParts(at.slot), table.currency(at.slot));
+        }, [&] { table.settle(at); });
+    }
+
+    // The last n logged records touching accNo (its opening included), newest
+    // first. Reads go through the per-account index, which first catches up
+    // with whatever was logged since the previous query.
+    Result<vector<Transaction>> recentTransactions(int accNo, size_t n) {
+        AccountTable::Lookup at;
+        if (!stripes.read(accNo, [&] { return (at = table.lookup(accNo)).slot != AccountTable::npos; },
+                          [&] { table.settle(at); }))
+            return TxStatus::AccountNotFound;
+        wal->flush();   // every committed record is in the file
+        lock_guard<mutex> lk(historyLock);
+        if (!history) history.reset(new TransactionHistory(historyIndexFile, transactionsFile));
+        history->refresh();
+        vector<Transaction> out = history->recent(accNo, n);
+        if (out.size() < n) {   // older records live in the sealed segments
+            uint64_t newest = 0;
+            for (const char* suffix : {".log", ".arc"})
+                for (auto& seg : logSegments(transactionsFile, suffix)) newest = max(newest, seg.first);
+            for (uint64_t seq = newest; seq > 0 && out.size() < n; --seq)
+                recentInSegment(seq, accNo, n - out.size(), out);
+        }
+        return out;
+    }
+
+    // Apply many transfers with one lock acquisition and one log commit.
+    // Rows are judged in order, exactly as if tryTransfer ran on each one,
+    // but nothing throws per row: every row gets a TxStatus. Only log I/O
+    // failures throw.
+    vector<TxStatus> transferBatch(const TransferRequest* reqs, size_t n) {
+        vector<TxStatus> result = applyBatch(reqs, n);
+        for (TxStatus st : result) countTransfer(st);
+        if (capture.load(memory_order_relaxed)) {
+            for (size_t i = 0; i < n; ++i) traceOp(TraceOp::Transfer, reqs[i].fromAcc, reqs[i].toAcc, reqs[i].amount, result[i]);
+        }
+        return result;
+    }
+
+    vector<TxStatus> transferBatch(const vector<TransferRequest>& reqs) {
+        return transferBatch(reqs.data(), reqs.size());
+    }
+
+private:
+    vector<TxStatus> applyBatch(const TransferRequest* reqs, size_t n) {
+        vector<TxStatus> result(n, TxStatus::Ok);
+        if (n == 0) return result;
+
+        // Pass 1: amount validation, a branch-free sweep over the rows
+        for (size_t i = 0; i < n; ++i)
+            result[i] = reqs[i].amount.isPositive() ? TxStatus::Ok : TxStatus::InvalidAmount;
+
+        vector<size_t> stripeIds;
+        stripeIds.reserve(2 * n);
+        for (size_t i = 0; i < n; ++i) {
+            stripeIds.push_back(LockStripes::stripeOf(reqs[i].fromAcc));
+            stripeIds.push_back(LockStripes::stripeOf(reqs[i].toAcc));
+        }
+        string records;
+        uint64_t ticket = 0;
+        chrono::steady_clock::time_point started;
+        {
+            StripeSetLock lk(stripes, std::move(stripeIds));
+
+            // Resolve both ends of every row to store slots
+            const uint32_t missing = numeric_limits<uint32_t>::max();
+            vector<uint32_t> fromSlot(n), toSlot(n);
+            vector<uint32_t> touched;
+            touched.reserve(2 * n);
+            const size_t ahead = 8;             // rows prefetched in advance
+            for (size_t i = 0; i < min(n, ahead); ++i) {
+                table.prefetch(reqs[i].fromAcc);
+                table.prefetch(reqs[i].toAcc);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (i + ahead < n) {
+                    table.prefetch(reqs[i + ahead].fromAcc);
+                    table.prefetch(reqs[i + ahead].toAcc);
+                }
+                size_t f = table.find(reqs[i].fromAcc);
+                size_t t = table.find(reqs[i].toAcc);
+                fromSlot[i] = f == AccountTable::npos ? missing : (uint32_t)f;
+                toSlot[i] = t == AccountTable::npos ? missing : (uint32_t)t;
+                if (fromSlot[i] == missing || toSlot[i] == missing) {
+                    if (result[i] == TxStatus::Ok) result[i] = TxStatus::AccountNotFound;
+                    continue;
+                }
+                touched.push_back(fromSlot[i]);
+                touched.push_back(toSlot[i]);
+            }
+
+            // Group by account: one dense, slot-ordered working balance per account
+            sort(touched.begin(), touched.end());
+            touched.erase(unique(touched.begin(), touched.end()), touched.end());
+            // a hot account in the batch is settled whole: its stripe is held
+            const HotSet* hot = hotSet.load(memory_order_relaxed);
+            if (!hot->accounts.empty()) {
+                for (uint32_t slot : touched) {
+                    HotBalance* h = hot->find(table.accNumber(slot));
+                    if (h) table.balanceMinor(slot) += h->drain();
+                }
+            }
+            vector<int64_t> working(touched.size());
+            for (size_t j = 0; j < touched.size(); ++j)
+                working[j] = table.balanceMinor(touched[j]);
+            auto dense = [&](uint32_t slot) {
+                return (size_t)(lower_bound(touched.begin(), touched.end(), slot) - touched.begin());
+            };
+
+            // Pass 2: admit rows in order against the running balances
+            for (size_t i = 0; i < n; ++i) {
+                if (result[i] != TxStatus::Ok) continue;
+                const TransferRequest& r = reqs[i];
+                Currency cur = r.amount.currency();
+                if (table.currency(fromSlot[i]) != cur || table.currency(toSlot[i]) != cur) {
+                    result[i] = TxStatus::CurrencyMismatch;
+                    continue;
+                }
+                size_t f = dense(fromSlot[i]), t = dense(toSlot[i]);
+                int64_t amt = r.amount.minorUnits();
+                if (working[f] < amt) {
+                    result[i] = TxStatus::InsufficientFunds;
+                    continue;
+                }
+                working[f] -= amt;
+                working[t] += amt;
+                Transaction(r.fromAcc, r.toAcc, r.amount, "transfer").appendRecord(records);
+            }
+            if (records.empty()) return result;
+
+            // Log first, then write back each account's net result once
+            ticket = appendLog(records, started);
+            for (size_t j = 0; j < touched.size(); ++j) table.balanceMinor(touched[j]) = working[j];
+        }
+        waitLogged(ticket, started);
+        return result;
+    }
+
+public:
+    // Utility: deposit using object pass & return
+    BankAccount depositToAccount(BankAccount acc, Money amount) {
+        // acc passed by value (object passed) and returned by value (object returned)
+        // (callers can std::move the account in; the return is a move as well)
+        if (!amount.isPositive()) throw invalid_argument("Deposit amount must be positive.");
+        acc += amount;      // in place, no temporary
+        return acc;
+    }
+
+    // Utility: withdraw by reference (pass-by-reference)
+    void withdrawFromAccount(vector<BankAccount>& list, int accNo, Money amount) {
+        int idx = findAccountIndex(list, accNo);
+        if (idx == -1) throw runtime_error("Account not found.");
+        // in-place operator-=, no temporary copy
+        list[idx] -= amount;
+    }
+
+    // Non-throwing variant of withdrawFromAccount
+    Result<void> tryWithdrawFromAccount(vector<BankAccount>& list, int accNo, Money amount) {
+        int idx = findAccountIndex(list, accNo);
+        if (idx == -1) return TxStatus::AccountNotFound;
+        return list[idx].withdraw(amount);
+    }
+};
+
+// --------------------------- 6a) ASYNC TRANSFER QUEUE ---------------------------
+// Non-blocking front end for API threads: submit() puts a transfer on a
+// bounded lock-free ring and returns a future; applier threads drain the
+// rings in batches through AccountManager::transferBatch, so the rules and
+// statuses are exactly those of tryTransfer and each batch is one log commit.
+// Transfers are routed to an applier by source account, so transfers out of
+// one account are applied in submission order. A full ring either rejects
+// (a ready future holding TxStatus::QueueFull) or makes the caller wait,
+// depending on blockWhenFull. Log I/O failures reach the futures as the
+// exception transferBatch threw.
+struct TransferQueueConfig {
+    size_t capacity = 4096;             // per applier, rounded up to a power of two
+    unsigned appliers = 1;
+    size_t maxBatch = 256;              // transfers per transferBatch call
+    bool blockWhenFull = false;         // wait for room instead of rejecting
+};
+
+struct TransferQueueMetrics {
+    size_t depth = 0;                   // queued, not yet taken by an applier
+    size_t peakDepth = 0;
+    uint64_t submitted = 0;
+    uint64_t rejected = 0;              // refused because a ring was full
+    uint64_t applied = 0;               // completed (any status)
+    uint64_t batches = 0;
+};
+
+// Bounded multi-producer ring (Vyukov): every slot carries a sequence number
+// that tells producers and the consumer whose turn the slot is, so neither
+// side takes a lock. Exactly one thread may pop. Items are moved in and out.
+template<typename T>
+class MpscRing {
+private:
+    struct Slot {
+        atomic<size_t> seq;
+        T item;
+    };
+    unique_ptr<Slot[]> slots;
+    const size_t mask;
+    alignas(64) atomic<size_t> tail{0};   // next position producers claim
+    alignas(64) atomic<size_t> head{0};   // next position the consumer takes
+
+    static size_t roundUp(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+public:
+    explicit MpscRing(size_t capacity) : slots(new Slot[roundUp(capacity)]), mask(roundUp(capacity) - 1) {
+        for (size_t i = 0; i <= mask; ++i) slots[i].seq.store(i, memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+    size_t depth() const {
+        size_t h = head.load(memory_order_relaxed);
+        size_t t = tail.load(memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    // False if the ring is full; item is left untouched then
+    bool push(T& item) {
+        size_t pos = tail.load(memory_order_relaxed);
+        Slot* s;
+        for (;;) {
+            s = &slots[pos & mask];
+            size_t seq = s->seq.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;   // the consumer has not freed this slot yet
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+        s->item = std::move(item);
+        s->seq.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    bool ready() const {
+        size_t pos = head.load(memory_order_relaxed);
+        return slots[pos & mask].seq.load(memory_order_acquire) == pos + 1;
+    }
+
+    // Consumer only
+    bool pop(T& item) {
+        size_t pos = head.load(memory_order_relaxed);
+        Slot& s = slots[pos & mask];
+        if (s.seq.load(memory_order_acquire) != pos + 1) return false;
+        item = std::move(s.item);
+        s.seq.store(pos + capacity(), memory_order_release);
+        head.store(pos + 1, memory_order_relaxed);
+        return true;
+    }
+};
+
+// A transfer waiting in a TransferQueue ring
+struct QueuedTransfer {
+    TransferRequest req;
+    promise<TxStatus> done;
+};
+using TransferRing = MpscRing<QueuedTransfer>;
+
+class TransferQueue {
+private:
+    struct Shard {
+        TransferRing ring;
+        thread applier;
+        mutex m;                        // only for sleeping and waking the applier
+        condition_variable wake;
+        atomic<bool> sleeping{false};
+        atomic<size_t> peakDepth{0};
+        atomic<uint64_t> applied{0};
+        atomic<uint64_t> batches{0};
+        explicit Shard(size_t capacity) : ring(capacity) {}
+    };
+
+    AccountManager& mgr;
+    const TransferQueueConfig cfg;
+    vector<unique_ptr<Shard>> shards;
+    atomic<bool> stopping{false};
+    atomic<uint64_t> submitted{0};
+    atomic<uint64_t> rejected{0};
+
+    Shard& shardOf(int fromAcc) {
+        return *shards[(size_t)(((uint64_t)(uint32_t)fromAcc * 0x9E3779B97F4A7C15ull) >> 32) % shards.size()];
+    }
+
+    void run(Shard& sh) {
+        vector<TransferRequest> reqs;
+        vector<promise<TxStatus>> waiters;
+        reqs.reserve(cfg.maxBatch);
+        waiters.reserve(cfg.maxBatch);
+        QueuedTransfer item;
+        for (;;) {
+            while (reqs.size() < cfg.maxBatch && sh.ring.pop(item)) {
+                reqs.push_back(item.req);
+                waiters.push_back(std::move(item.done));
+            }
+            if (reqs.empty()) {
+                if (stopping.load()) break;   // stopping and drained
+                sh.sleeping.store(true);
+                atomic_thread_fence(memory_order_seq_cst);   // pairs with the fence in submit()
+                {
+                    unique_lock<mutex> lk(sh.m);
+                    sh.wake.wait(lk, [&] { return stopping.load() || sh.ring.ready(); });
+                }
+                sh.sleeping.store(false);
+                continue;
+            }
+            vector<TxStatus> st;
+            exception_ptr failure;
+            try {
+                st = mgr.transferBatch(reqs);
+            } catch (...) {
+                failure = current_exception();
+            }
+            // count before completing, so a caller holding the outcome sees it in metrics()
+            sh.applied.fetch_add(reqs.size(), memory_order_relaxed);
+            sh.batches.fetch_add(1, memory_order_relaxed);
+            for (size_t i = 0; i < waiters.size(); ++i) {
+                if (failure) waiters[i].set_exception(failure);
+                else waiters[i].set_value(st[i]);
+            }
+            reqs.clear();
+            waiters.clear();
+        }
+    }
+
+public:
+    explicit TransferQueue(AccountManager& mgr, const TransferQueueConfig& cfg = TransferQueueConfig())
+        : mgr(mgr), cfg(cfg) {
+        if (cfg.appliers == 0 || cfg.capacity == 0 || cfg.maxBatch == 0)
+            throw invalid_argument("Transfer queue needs at least one applier, slot and batch row.");
+        for (unsigned i = 0; i < cfg.appliers; ++i) shards.emplace_back(new Shard(cfg.capacity));
+        for (auto& sh : shards) sh->applier = thread(&TransferQueue::run, this, ref(*sh));
+    }
+
+    // Drains everything already queued, then stops the appliers
+    ~TransferQueue() {
+        stopping.store(true);
+        for (auto& sh : shards) {
+            { lock_guard<mutex> lk(sh->m); }
+            sh->wake.notify_one();
+            sh->applier.join();
+        }
+    }
+
+    TransferQueue(const TransferQueue&) = delete;
+    TransferQueue& operator=(const TransferQueue&) = delete;
+
+    // Queue a transfer; the future yields its status once applied
+    future<TxStatus> submit(const TransferRequest& req) {
+        if (stopping.load(memory_order_relaxed)) throw logic_error("Transfer queue is stopped.");
+        QueuedTransfer item{req, promise<TxStatus>()};
+        future<TxStatus> outcome = item.done.get_future();
+        Shard& sh = shardOf(req.fromAcc);
+        while (!sh.ring.push(item)) {
+            if (!cfg.blockWhenFull) {
+                rejected.fetch_add(1, memory_order_relaxed);
+                item.done.set_value(TxStatus::QueueFull);
+                return outcome;
+            }
+            this_thread::yield();
+        }
+        submitted.fetch_add(1, memory_order_relaxed);
+        size_t d = sh.ring.depth();
+        size_t peak = sh.peakDepth.load(memory_order_relaxed);
+        while (d > peak && !sh.peakDepth.compare_exchange_weak(peak, d, memory_order_relaxed)) {}
+        atomic_thread_fence(memory_order_seq_cst);   // the push is visible before sleeping is read
+        if (sh.sleeping.load()) {
+            lock_guard<mutex> lk(sh.m);   // the applier is either before its check or waiting
+            sh.wake.notify_one();
+        }
+        return outcome;
+    }
+
+    future<TxStatus> submit(int fromAcc, int toAcc, Money amount) { return submit(TransferRequest{fromAcc, toAcc, amount}); }
+
+    TransferQueueMetrics metrics() const {
+        TransferQueueMetrics m;
+        m.submitted = submitted.load(memory_order_relaxed);
+        m.rejected = rejected.load(memory_order_relaxed);
+        for (const auto& sh : shards) {
+            m.depth += sh->ring.depth();
+            m.peakDepth = max(m.peakDepth, sh->peakDepth.load(memory_order_relaxed));
+            m.applied += sh->applied.load(memory_order_relaxed);
+            m.batches += sh->batches.load(memory_order_relaxed);
+        }
+        return m;
+    }
+};
+
+// --------------------------- 6b) SHARDED ACCOUNTS -------------------------------
+// Shared-nothing alternative to AccountManager's lock stripes. Accounts are
+// partitioned by accNumber hash over N shards; each shard has its own table,
+// snapshot (accounts.<i>.dat) and log segment (transactions.<i>.txt) and one
+// owner thread, the only thread that ever touches the shard's data, so
+// nothing inside a shard is locked. Work reaches the owner as messages on the
+// shard's inbox, an MpscRing (6a); the owner takes them in batches, makes the
+// batch's log records durable once and only then sends the answers out.
+// Same-shard transfers are a single message. Cross-shard transfers use two
+// phases and pass from shard to shard without the caller in between: the
+// source prepares (validates and holds the debit, logging "prepare:<id>"),
+// the destination credits ("credit:<id>"), and the source then logs
+// "commit:<id>" -- or "abort:<id>" and refunds if the credit was refused --
+// and answers the caller. A prepare left open by a crash is settled at the
+// next start by whether the destination's log holds the matching credit.
+struct ShardedAccountConfig {
+    unsigned shards = 4;
+    string directory = ".";                        // where the per-shard files live
+    Durability durability = Durability::Durable;
+    chrono::microseconds groupCommitWindow{200};   // for calls; transfers flush once per owner batch
+    size_t inboxCapacity = 4096;                   // messages per shard, rounded up to a power of two
+    size_t maxBatch = 256;                         // messages an owner takes per durable point
+};
+
+class AccountShard {
+public:
+    // A caller waiting for the answer to its message; lives on the caller's stack
+    struct Waiter {
+        mutex m;
+        condition_variable answered;
+        bool done = false;
+        TxStatus status = TxStatus::Ok;
+        exception_ptr failure;
+
+        void complete(TxStatus st, exception_ptr e = nullptr) {
+            lock_guard<mutex> lk(m);
+            status = st;
+            failure = e;
+            done = true;
+            answered.notify_one();
+        }
+
+        TxStatus wait() {
+            unique_lock<mutex> lk(m);
+            answered.wait(lk, [this] { return done; });
+            if (failure) rethrow_exception(failure);
+            return status;
+        }
+    };
+
+    struct Message {
+        enum class Kind : uint8_t { Call, Transfer, Prepare, Credit, Finish };
+        Kind kind = Kind::Call;
+        TxStatus status = TxStatus::Ok;    // Credit: the source's verdict; Finish: Ok commits
+        int fromAcc = 0;
+        int toAcc = 0;
+        Money amount;
+        uint64_t id = 0;                   // cross-shard transfer number
+        AccountShard* peer = nullptr;      // the other shard of a cross-shard transfer
+        Waiter* waiter = nullptr;
+        void (*call)(void*) = nullptr;     // Call: call(context) on the owner
+        void* context = nullptr;
+    };
+
+private:
+    struct Hold {
+        int fromAcc;
+        int toAcc;
+        Money amount;
+    };
+
+    // An answer or a message for another shard, sent after the batch's durable point
+    struct Outgoing {
+        Message msg;
+        AccountShard* to;                  // nullptr: complete msg.waiter with msg.status
+        bool logged;                       // depends on a record of this batch
+    };
+
+    const string snapshotFile;
+    const string logFile;
+    const string runId;                        // prefix of the transfer ids in the log
+    const Durability durability;
+    const size_t maxBatch;
+    AccountTable table;
+    unique_ptr<WriteAheadLog> wal;
+    unordered_map<string, Hold> holds;         // prepared, not yet committed or aborted
+    unordered_set<string> credited;            // cross-shard credits in the replayed log
+    int64_t discard = 0;                       // sink for records of accounts this shard never had
+    string record;                             // log line buffer, reused
+    MpscRing<Message> inbox;
+    mutex sleepLock;                           // only for sleeping and waking the owner
+    condition_variable wake;
+    atomic<bool> sleeping{false};
+    atomic<bool> stopping{false};
+    thread owner;
+
+    static constexpr const char* openNote = "open:";
+
+    static bool hasTag(const string& note, const char* tag) { return note.compare(0, strlen(tag), tag) == 0; }
+    static string idOf(const string& note) { return note.substr(note.find(':') + 1); }
+    string idOf(uint64_t id) const { return runId + "." + to_string(id); }
+
+    int64_t& minorOf(int accNumber) {
+        size_t slot = table.find(accNumber);
+        return slot == AccountTable::npos ? (discard = 0) : table.balanceMinor(slot);
+    }
+
+    // Redo one record of this shard's log
+    void applyLogged(const Transaction& tx) {
+        const string& note = tx.getNote();
+        int64_t amt = tx.getAmount().minorUnits();
+        if (tx.getFromAcc() == 0 && hasTag(note, openNote)) {
+            table.upsert(tx.getToAcc(), string_view(note).substr(strlen(openNote)), tx.getAmount());
+        } else if (hasTag(note, "prepare:")) {
+            minorOf(tx.getFromAcc()) -= amt;
+            holds[idOf(note)] = {tx.getFromAcc(), tx.getToAcc(), tx.getAmount()};
+        } else if (hasTag(note, "commit:")) {
+            holds.erase(idOf(note));
+        } else if (hasTag(note, "abort:")) {
+            minorOf(tx.getFromAcc()) += amt;
+            holds.erase(idOf(note));
+        } else if (hasTag(note, "credit:")) {
+            minorOf(tx.getToAcc()) += amt;
+            credited.insert(idOf(note));
+        } else {
+            minorOf(tx.getFromAcc()) -= amt;
+            minorOf(tx.getToAcc()) += amt;
+        }
+    }
+
+    uint64_t log(int fromAcc, int toAcc, Money amount, const string& note) {
+        record.clear();
+        Transaction(fromAcc, toAcc, amount, note).appendRecord(record);
+        return wal->append(record);
+    }
+
+    // Put m on the inbox if there is room, waking the owner
+    bool offer(Message& m) {
+        if (!inbox.push(m)) return false;
+        atomic_thread_fence(memory_order_seq_cst);   // the push is visible before sleeping is read
+        if (sleeping.load()) {
+            lock_guard<mutex> lk(sleepLock);         // the owner is either before its check or waiting
+            wake.notify_one();
+        }
+        return true;
+    }
+
+    // One message on the owner thread; what it sends goes to out
+    void handle(Message& m, vector<Outgoing>& out, bool& logged) {
+        uint64_t ticket = 0;
+        switch (m.kind) {
+        case Message::Kind::Call:
+            m.call(m.context);
+            m.waiter->complete(TxStatus::Ok);
+            return;
+        case Message::Kind::Transfer:
+            m.status = transfer(m.fromAcc, m.toAcc, m.amount, ticket);
+            out.push_back({m, nullptr, m.status == TxStatus::Ok});
+            break;
+        case Message::Kind::Prepare:
+            // a missing source is final; any other verdict waits for the destination's
+            m.status = prepare(idOf(m.id), m.fromAcc, m.toAcc, m.amount, ticket);
+            if (m.status == TxStatus::AccountNotFound) {
+                out.push_back({m, nullptr, false});
+            } else {
+                AccountShard* dst = m.peer;
+                m.kind = Message::Kind::Credit;
+                m.peer = this;
+                out.push_back({m, dst, m.status == TxStatus::Ok});
+            }
+            break;
+        case Message::Kind::Credit: {
+            TxStatus st = check(m.toAcc, m.amount);
+            if (m.status != TxStatus::Ok) {       // nothing held: rank the two verdicts as tryTransfer does
+                if (st != TxStatus::Ok) m.status = st;
+                out.push_back({m, nullptr, false});
+                break;
+            }
+            m.status = credit(idOf(m.id), m.fromAcc, m.toAcc, m.amount, ticket);
+            m.kind = Message::Kind::Finish;            // the commit decision, once the credit is durable
+            out.push_back({m, m.peer, m.status == TxStatus::Ok});
+            break;
+        }
+        case Message::Kind::Finish:
+            ticket = finish(idOf(m.id), m.status == TxStatus::Ok);
+            out.push_back({m, nullptr, true});
+            break;
+        }
+        logged = logged || ticket != 0;
+    }
+
+    void serve() {
+        vector<Message> batch;
+        vector<Outgoing> out, blocked;          // blocked: messages a full peer inbox refused
+        batch.reserve(maxBatch);
+        Message m;
+        for (;;) {
+            for (size_t i = 0; i < blocked.size();) {
+                if (blocked[i].to->offer(blocked[i].msg)) {
+                    blocked[i] = std::move(blocked.back());
+                    blocked.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+            while (batch.size() < maxBatch && inbox.pop(m)) batch.push_back(m);
+            if (batch.empty()) {
+                if (!blocked.empty()) {
+                    this_thread::yield();
+                    continue;
+                }
+                if (stopping.load()) break;   // stopping and drained
+                sleeping.store(true);
+                atomic_thread_fence(memory_order_seq_cst);   // pairs with the fence in offer()
+                {
+                    unique_lock<mutex> lk(sleepLock);
+                    wake.wait(lk, [&] { return stopping.load() || inbox.ready(); });
+                }
+                sleeping.store(false);
+                continue;
+            }
+
+            bool logged = false;
+            for (Message& msg : batch) {
+                try {
+                    handle(msg, out, logged);
+                } catch (...) {
+                    msg.waiter->complete(TxStatus::Ok, current_exception());
+                }
+            }
+            // one durable point for the batch; Buffered mode never waits, as waitDurable
+            exception_ptr failure;
+            if (logged && durability == Durability::Durable) {
+                try {
+                    wal->flush();
+                } catch (...) {
+                    failure = current_exception();
+                }
+            }
+            for (Outgoing& o : out) {
+                if (failure && o.logged) o.msg.waiter->complete(TxStatus::Ok, failure);
+                else if (!o.to) o.msg.waiter->complete(o.msg.status);
+                else if (!o.to->offer(o.msg)) blocked.push_back(o);
+            }
+            out.clear();
+            batch.clear();
+        }
+    }
+
+public:
+    AccountShard(const string& snapshotFile, const string& logFile, const string& runId,
+                 const ShardedAccountConfig& cfg)
+        : snapshotFile(snapshotFile), logFile(logFile), runId(runId), durability(cfg.durability),
+          maxBatch(max<size_t>(cfg.maxBatch, 1)), inbox(cfg.inboxCapacity) {
+        uint64_t offset = 0;
+        if (fileExists(snapshotFile)) {
+            MappedFile file(snapshotFile);
+            offset = decodeAccountFile(file, [this](const AccountRecord& r, string_view name) { table.upsert(r, name); });
+        }
+        if (fileExists(logFile)) {
+            TransactionLogReader reader(logFile, offset);
+            Transaction tx;
+            uint64_t at;
+            while (reader.next(tx, at)) applyLogged(tx);
+            if (reader.position() >= offset && reader.position() < fileSize(logFile) &&
+                ::truncate(logFile.c_str(), (off_t)reader.position()) != 0)
+                throw runtime_error("Unable to repair transaction file.");
+        }
+        wal.reset(new WriteAheadLog(logFile, cfg.durability, cfg.groupCommitWindow));
+        owner = thread(&AccountShard::serve, this);
+    }
+
+    // Answers everything already queued, then stops the owner
+    ~AccountShard() {
+        stopping.store(true);
+        {
+            lock_guard<mutex> lk(sleepLock);
+        }
+        wake.notify_one();
+        owner.join();
+    }
+
+    AccountShard(const AccountShard&) = delete;
+    AccountShard& operator=(const AccountShard&) = delete;
+
+    // Queue m for the owner, waiting for room; m.waiter gets the answer
+    void post(Message& m) {
+        while (!offer(m)) this_thread::yield();
+    }
+
+    // Run f on the owner thread and return its result. Everything below is
+    // only for functions passed to run(); never call run() from inside one.
+    template<typename F>
+    auto run(F&& f) -> decltype(f()) {
+        using R = decltype(f());
+        if constexpr (is_void_v<R>) {
+            call([&] { f(); });
+        } else {
+            optional<R> out;
+            call([&] { out.emplace(f()); });
+            return std::move(*out);
+        }
+    }
+
+    template<typename G>
+    void call(G&& g) {
+        Waiter w;
+        Message m;
+        m.waiter = &w;
+        m.context = &g;
+        m.call = [](void* p) { (*static_cast<remove_reference_t<G>*>(p))(); };
+        post(m);
+        w.wait();
+    }
+
+    WriteAheadLog& logSegment() { return *wal; }
+    bool has(int accNumber) const { return table.find(accNumber) != AccountTable::npos; }
+    bool wasCredited(const string& id) const { return credited.count(id) > 0; }
+    vector<string> openHolds() const {
+        vector<string> ids;
+        for (const auto& h : holds) ids.push_back(h.first);
+        return ids;
+    }
+
+    uint64_t create(const BankAccount& acc) {
+        uint64_t ticket = log(0, acc.getAccNumber(), acc.getBalanceConstRef(), openNote + acc.getName());
+        table.upsert(acc.getAccNumber(), acc.getName(), acc.getBalanceConstRef());
+        return ticket;
+    }
+
+    Result<Money> balance(int accNumber) const {
+        size_t slot = table.find(accNumber);
+        if (slot == AccountTable::npos) return TxStatus::AccountNotFound;
+        return table.balance(slot);
+    }
+
+    // NotFound / CurrencyMismatch / Ok for an account taking part in a transfer
+    TxStatus check(int accNumber, Money amount) const {
+        size_t slot = table.find(accNumber);
+        if (slot == AccountTable::npos) return TxStatus::AccountNotFound;
+        return table.currency(slot) == amount.currency() ? TxStatus::Ok : TxStatus::CurrencyMismatch;
+    }
+
+    // Both accounts live here: the rules of AccountManager::tryTransfer
+    TxStatus transfer(int fromAcc, int toAcc, Money amount, uint64_t& ticket) {
+        size_t src = table.find(fromAcc);
+        size_t dst = table.find(toAcc);
+        if (src == AccountTable::npos || dst == AccountTable::npos) return TxStatus::AccountNotFound;
+        if (table.currency(src) != amount.currency() || table.currency(dst) != amount.currency())
+            return TxStatus::CurrencyMismatch;
+        int64_t amt = amount.minorUnits();
+        if (table.balance(src).minorUnits() < amt) return TxStatus::InsufficientFunds;
+        ticket = log(fromAcc, toAcc, amount, "transfer");
+        table.balanceMinor(src) -= amt;
+        table.balanceMinor(dst) += amt;
+        return TxStatus::Ok;
+    }
+
+    // Phase 1 of a cross-shard transfer, on the source shard
+    TxStatus prepare(const string& id, int fromAcc, int toAcc, Money amount, uint64_t& ticket) {
+        TxStatus st = check(fromAcc, amount);
+        if (st != TxStatus::Ok) return st;
+        size_t src = table.find(fromAcc);
+        if (table.balance(src).minorUnits() < amount.minorUnits()) return TxStatus::InsufficientFunds;
+        ticket = log(fromAcc, toAcc, amount, "prepare:" + id);
+        table.balanceMinor(src) -= amount.minorUnits();
+        holds[id] = {fromAcc, toAcc, amount};
+        return TxStatus::Ok;
+    }
+
+    // Phase 2, on the destination shard
+    TxStatus credit(const string& id, int fromAcc, int toAcc, Money amount, uint64_t& ticket) {
+        TxStatus st = check(toAcc, amount);
+        if (st != TxStatus::Ok) return st;
+        ticket = log(fromAcc, toAcc, amount, "credit:" + id);
+        table.balanceMinor(table.find(toAcc)) += amount.minorUnits();
+        return TxStatus::Ok;
+    }
+
+    // Close a prepared transfer on the source shard; an abort refunds the hold
+    uint64_t finish(const string& id, bool commit) {
+        auto it = holds.find(id);
+        if (it == holds.end()) throw logic_error("No prepared transfer " + id + ".");
+        Hold h = it->second;
+        holds.erase(it);
+        uint64_t ticket = log(h.fromAcc, h.toAcc, h.amount, (commit ? "commit:" : "abort:") + id);
+        if (!commit) minorOf(h.fromAcc) += h.amount.minorUnits();
+        return ticket;
+    }
+
+    int holdDestination(const string& id) const { return holds.at(id).toAcc; }
+
+    void collect(vector<BankAccount>& out) const {
+        for (size_t i = 0; i < table.size(); ++i) out.push_back(table.materialize(i));
+    }
+
+    // Snapshot the shard; the caller makes sure no transfer is half done
+    void checkpoint() {
+        uint64_t covered = wal->flush();
+        writeFileAtomically(snapshotFile, encodeAccountFile(table, covered));
+        credited.clear();
+    }
+};
+
+class ShardedAccountManager {
+private:
+    const string runId;                        // makes transfer ids unique across restarts
+    vector<unique_ptr<AccountShard>> shards;
+    shared_mutex crossShard;                   // cross-shard transfers shared, checkpoints exclusive
+    atomic<uint64_t> nextId{0};
+
+    AccountShard& shardFor(int accNumber) { return *shards[shardOf(accNumber)]; }
+
+    // Settle prepares a crash left open: committed if the credit reached the
+    // destination's log, refunded otherwise
+    void settleOpenHolds() {
+        for (auto& sh : shards) {
+            for (const string& id : sh->run([&] { return sh->openHolds(); })) {
+                int toAcc = sh->run([&] { return sh->holdDestination(id); });
+                AccountShard& dst = shardFor(toAcc);
+                bool credited = dst.run([&] { return dst.wasCredited(id); });
+                uint64_t ticket = sh->run([&] { return sh->finish(id, credited); });
+                sh->logSegment().waitDurable(ticket);
+            }
+        }
+    }
+
+public:
+    explicit ShardedAccountManager(const ShardedAccountConfig& cfg = ShardedAccountConfig())
+        : runId(to_string(chrono::duration_cast<chrono::microseconds>(
+                chrono::system_clock::now().time_since_epoch()).count())) {
+        if (cfg.shards == 0) throw invalid_argument("At least one shard is required.");
+        for (unsigned i = 0; i < cfg.shards; ++i) {
+            string n = to_string(i);
+            shards.emplace_back(new AccountShard(cfg.directory + "/accounts." + n + ".dat",
+                                                 cfg.directory + "/transactions." + n + ".txt", runId, cfg));
+        }
+        settleOpenHolds();
+    }
+
+    size_t shardCount() const { return shards.size(); }
+    size_t shardOf(int accNumber) const {
+        return (size_t)((((uint64_t)(uint32_t)accNumber * 0x9E3779B97F4A7C15ull) >> 32) % shards.size());
+    }
+
+    void createAccount(const BankAccount& acc) {
+        AccountShard& sh = shardFor(acc.getAccNumber());
+        uint64_t ticket = sh.run([&] { return sh.create(acc); });
+        sh.logSegment().waitDurable(ticket);
+    }
+
+    Result<Money> balanceOf(int accNo) {
+        AccountShard& sh = shardFor(accNo);
+        return sh.run([&] { return sh.balance(accNo); });
+    }
+
+    // Same statuses as AccountManager::tryTransfer. One message to the source
+    // shard; a cross-shard transfer then travels source -> destination ->
+    // source, and the answer comes once its last record is durable.
+    Result<void> tryTransfer(int fromAcc, int toAcc, Money amount) {
+        if (!amount.isPositive()) return TxStatus::InvalidAmount;
+        AccountShard& src = shardFor(fromAcc);
+        AccountShard& dst = shardFor(toAcc);
+        AccountShard::Waiter w;
+        AccountShard::Message m;
+        m.fromAcc = fromAcc;
+        m.toAcc = toAcc;
+        m.amount = amount;
+        m.waiter = &w;
+        if (&src == &dst) {
+            m.kind = AccountShard::Message::Kind::Transfer;
+            src.post(m);
+            return w.wait();
+        }
+        shared_lock<shared_mutex> lk(crossShard);
+        m.kind = AccountShard::Message::Kind::Prepare;
+        m.id = nextId.fetch_add(1, memory_order_relaxed);
+        m.peer = &dst;
+        src.post(m);
+        return w.wait();
+    }
+
+    vector<BankAccount> loadAllAccounts() {
+        vector<BankAccount> list;
+        for (auto& sh : shards) sh->run([&] { sh->collect(list); });
+        return list;
+    }
+
+    // Snapshot every shard at a point where no cross-shard transfer is open
+    void checkpoint() {
+        unique_lock<shared_mutex> lk(crossShard);
+        for (auto& sh : shards) sh->run([&] { sh->checkpoint(); });
+    }
+};
+
+// --------------------------- 6c) COROUTINE API (C++20) ---------------------------
+// co_await-able front end over an AccountManager, compiled only as C++20
+// (g++ -std=c++20). Task<T> is lazy: it starts when first awaited, and
+// startTask() runs one to completion from plain code, handing back a future.
+// A transfer awaits its log record through WriteAheadLog::whenDurable, so a
+// suspended transfer holds no thread while the fsync is pending; load, save
+// and checkpoint run on the executor pool. Every resumption happens on the
+// executor, never on the log's committer thread.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+
+template<typename T> class Task;
+
+namespace coro {
+
+struct PromiseBase {
+    coroutine_handle<> continuation;    // the awaiting coroutine
+    exception_ptr error;
+
+    suspend_always initial_suspend() noexcept { return {}; }
+
+    // hand control straight back to the awaiting coroutine
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template<typename P>
+        coroutine_handle<> await_suspend(coroutine_handle<P> h) noexcept {
+            coroutine_handle<> next = h.promise().continuation;
+            return next ? next : noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = current_exception(); }
+};
+
+template<typename T>
+struct Promise : PromiseBase {
+    optional<T> value;
+    Task<T> get_return_object();
+    void return_value(T v) { value.emplace(std::move(v)); }
+    T take() {
+        if (error) rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void take() {
+        if (error) rethrow_exception(error);
+    }
+};
+
+// Eager, self-destroying coroutine used to drive a Task from plain code
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+} // namespace coro
+
+template<typename T = void>
+class Task {
+public:
+    using promise_type = coro::Promise<T>;
+
+    Task(Task&& o) noexcept : h(exchange(o.h, nullptr)) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            if (h) h.destroy();
+            h = exchange(o.h, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (h) h.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+        h.promise().continuation = awaiting;
+        return h;
+    }
+    T await_resume() { return h.promise().take(); }
+
+private:
+    friend struct coro::Promise<T>;
+    explicit Task(coroutine_handle<promise_type> handle) : h(handle) {}
+    coroutine_handle<promise_type> h;
+};
+
+namespace coro {
+
+template<typename T>
+Task<T> Promise<T>::get_return_object() { return Task<T>(coroutine_handle<Promise<T>>::from_promise(*this)); }
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+template<typename T>
+Detached runInto(Task<T> task, promise<T> result) {
+    try {
+        if constexpr (is_void_v<T>) {
+            co_await task;
+            result.set_value();
+        } else {
+            result.set_value(co_await task);
+        }
+    } catch (...) {
+        result.set_exception(current_exception());
+    }
+}
+
+// Runs f() on pool, then resumes the awaiting coroutine on that worker
+template<typename F>
+class OffloadAwaiter {
+private:
+    using R = invoke_result_t<F&>;
+    ThreadPool& pool;
+    F f;
+    optional<conditional_t<is_void_v<R>, bool, R>> value;
+    exception_ptr error;
+public:
+    OffloadAwaiter(ThreadPool& p, F fn) : pool(p), f(std::move(fn)) {}
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> h) {
+        pool.post([this, h] {
+            try {
+                if constexpr (is_void_v<R>) {
+                    f();
+                    value.emplace(true);
+                } else {
+                    value.emplace(f());
+                }
+            } catch (...) {
+                error = current_exception();
+            }
+            h.resume();
+        });
+    }
+    R await_resume() {
+        if (error) rethrow_exception(error);
+        if constexpr (!is_void_v<R>) return std::move(*value);
+    }
+};
+
+// Applies a transfer at once and suspends until its log record is durable;
+// a refused transfer does not suspend at all
+class TransferAwaiter {
+private:
+    AccountManager& mgr;
+    ThreadPool& pool;
+    int fromAcc, toAcc;
+    Money amount;
+    TxStatus st = TxStatus::Ok;
+    bool durable = false;
+public:
+    TransferAwaiter(AccountManager& m, ThreadPool& p, int from, int to, Money amt)
+        : mgr(m), pool(p), fromAcc(from), toAcc(to), amount(amt) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(coroutine_handle<> h) {
+        TxStatus s = mgr.submitTransfer(fromAcc, toAcc, amount, [this, h](bool ok) {
+            durable = ok;
+            pool.post([h] { h.resume(); });
+        }).status();
+        if (s == TxStatus::Ok) return true;  // the callback resumes us; *this may be gone already
+        st = s;
+        return false;
+    }
+    Result<void> await_resume() const {
+        if (st == TxStatus::Ok && !durable) throw runtime_error("Unable to write transaction file.");
+        return st;
+    }
+};
+
+} // namespace coro
+
+// Start task on this thread and return a future for its outcome; the task
+// runs until its first suspension before startTask returns.
+template<typename T>
+future<T> startTask(Task<T> task) {
+    promise<T> result;
+    future<T> f = result.get_future();
+    coro::runInto(std::move(task), std::move(result));
+    return f;
+}
+
+// Coroutine versions of the AccountManager calls that wait on I/O. Statuses,
+// exceptions and balances are those of the blocking calls.
+class AsyncAccountManager {
+private:
+    AccountManager& mgr;
+    unique_ptr<ThreadPool> ownPool;
+    ThreadPool& pool;
+
+    template<typename F>
+    coro::OffloadAwaiter<F> offload(F f) { return {pool, std::move(f)}; }
+
+public:
+    AsyncAccountManager(AccountManager& m, ThreadPool& executor) : mgr(m), pool(executor) {}
+    explicit AsyncAccountManager(AccountManager& m, unsigned threads = 1)
+        : mgr(m), ownPool(new ThreadPool(threads)), pool(*ownPool) {}
+
+    AccountManager& manager() { return mgr; }
+    ThreadPool& executor() { return pool; }
+
+    Task<Result<void>> tryTransfer(int fromAcc, int toAcc, Money amount) {
+        co_return co_await coro::TransferAwaiter(mgr, pool, fromAcc, toAcc, amount);
+    }
+
+    Task<bool> transferFunds(int fromAcc, int toAcc, Money amount) {
+        Result<void> r = co_await coro::TransferAwaiter(mgr, pool, fromAcc, toAcc, amount);
+        co_return AccountManager::raiseTransferStatus(r.status());
+    }
+
+    Task<vector<BankAccount>> loadAllAccounts() {
+        co_return co_await offload([this] { return mgr.loadAllAccounts(); });
+    }
+
+    Task<void> saveAllAccounts(vector<BankAccount> list) {
+        co_await offload([this, &list] { mgr.saveAllAccounts(list); });
+    }
+
+    Task<uint64_t> checkpoint() {
+        co_return co_await offload([this] { return mgr.checkpoint(); });
+    }
+};
+#endif
+
+// --------------------------- 6d) LOAD GENERATOR ----------------------------------
+// Synthetic traffic for benchmarking a manager: transfers, deposits and
+// withdrawals over accounts firstAccount .. firstAccount + accounts - 1,
+// picked with Zipfian skew by account number (firstAccount is the hottest),
+// a share of them built to be refused, paced to a target rate. Each thread
+// draws from its own seeded stream, so a run is repeatable; with one
+// thread, capturing it (startCapture) and replaying the trace onto the same
+// starting accounts gives the same statuses and balances. Latency is taken
+// from each operation's scheduled start when paced, so falling behind the
+// rate shows up in the percentiles rather than being hidden.
+struct WorkloadConfig {
+    int firstAccount = 1;
+    int accounts = 10000;
+    Money openingBalance = Money(10000.0);     // seedWorkloadAccounts
+    double zipfSkew = 0.99;                    // theta in [0, 1); 0 is uniform
+    unsigned transferWeight = 80;              // operation mix, relative weights
+    unsigned depositWeight = 10;
+    unsigned withdrawWeight = 10;
+    double failureRate = 0.01;                 // share built to be refused
+    int64_t minAmountMinor = 100;
+    int64_t maxAmountMinor = 10000;
+    size_t operations = 100000;                // over all threads
+    double targetRate = 0;                     // operations per second over all threads; 0: unpaced
+    unsigned threads = 1;
+    uint64_t seed = 1;
+};
+
+struct WorkloadReport {
+    size_t operations = 0;
+    size_t byOp[traceOpCount] = {};
+    size_t byStatus[txStatusCount] = {};
+    size_t statusMismatches = 0;               // replayTrace only: statuses unlike the trace's
+    double seconds = 0;
+    HistogramSnapshot latency;
+
+    double throughput() const { return seconds > 0 ? operations / seconds : 0; }
+
+    string toText() const {
+        string out;
+        char line[200];
+        auto emit = [&](const char* fmt, auto... args) {
+            snprintf(line, sizeof line, fmt, args...);
+            out += line;
+        };
+        emit("%zu operations in %.3f s: %.0f ops/s\n", operations, seconds, throughput());
+        for (size_t k = 0; k < traceOpCount; ++k) emit("  %s %zu\n", traceOpName((TraceOp)k), byOp[k]);
+        for (size_t s = 0; s < txStatusCount; ++s) {
+            if (byStatus[s]) emit("  %s: %zu\n", statusMessage((TxStatus)s), byStatus[s]);
+        }
+        emit("latency us: p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", latency.percentile(0.5) / 1e3,
+             latency.percentile(0.9) / 1e3, latency.percentile(0.99) / 1e3, latency.percentile(0.999) / 1e3,
+             latency.maxNanos / 1e3);
+        if (statusMismatches) emit("status mismatches against the trace: %zu\n", statusMismatches);
+        return out;
+    }
+};
+
+// Zipfian ranks 0 .. n-1 with exponent theta < 1, in O(1) per draw after an
+// O(n) setup (Gray et al., "Quickly generating billion-record synthetic
+// databases"). Immutable once built: one instance serves every thread.
+class ZipfianSampler {
+private:
+    uint64_t n;
+    double theta, alpha, zetan, eta, half;
+
+public:
+    ZipfianSampler(uint64_t items, double skew) : n(max<uint64_t>(items, 1)), theta(skew) {
+        if (!(theta >= 0 && theta < 1)) throw invalid_argument("Zipfian skew must be in [0, 1).");
+        zetan = 0;
+        for (uint64_t i = 1; i <= n; ++i) zetan += 1 / pow((double)i, theta);
+        double zeta2 = 1 + 1 / pow(2.0, theta);
+        alpha = 1 / (1 - theta);
+        eta = n > 1 ? (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan) : 0;
+        half = 1 + pow(0.5, theta);
+    }
+
+    // Rank for u uniform in [0, 1)
+    uint64_t operator()(double u) const {
+        double uz = u * zetan;
+        if (uz < 1) return 0;
+        if (uz < half) return min<uint64_t>(1, n - 1);
+        return min<uint64_t>((uint64_t)(n * pow(eta * u - eta + 1, alpha)), n - 1);
+    }
+};
+
+struct WorkloadOp {
+    TraceOp op;
+    int fromAcc, toAcc;                        // 0 on the outside of a deposit or withdrawal
+    Money amount;
+};
+
+// One deterministic stream of operations
+class WorkloadGenerator {
+private:
+    const WorkloadConfig& cfg;
+    const ZipfianSampler& zipf;
+    uint64_t state;
+
+    uint64_t nextBits() {                      // splitmix64
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    double uniform() { return (nextBits() >> 11) * 0x1.0p-53; }
+    uint64_t below(uint64_t bound) { return bound ? nextBits() % bound : 0; }
+    int account() { return cfg.firstAccount + (int)zipf(uniform()); }
+
+public:
+    WorkloadGenerator(const WorkloadConfig& config, const ZipfianSampler& sampler, uint64_t stream)
+        : cfg(config), zipf(sampler), state(config.seed * 0x2545f4914f6cdd1dull + stream) {}
+
+    WorkloadOp next() {
+        WorkloadOp w;
+        uint64_t mix = below((uint64_t)cfg.transferWeight + cfg.depositWeight + cfg.withdrawWeight);
+        w.op = mix < cfg.transferWeight ? TraceOp::Transfer
+             : mix < (uint64_t)cfg.transferWeight + cfg.depositWeight ? TraceOp::Deposit : TraceOp::Withdraw;
+        int a = account(), b = account();
+        if (w.op == TraceOp::Transfer && b == a && cfg.accounts > 1)
+            b = cfg.firstAccount + (int)((b - cfg.firstAccount + 1) % cfg.accounts);
+        w.fromAcc = w.op == TraceOp::Deposit ? 0 : a;
+        w.toAcc = w.op == TraceOp::Withdraw ? 0 : w.op == TraceOp::Deposit ? a : b;
+        int64_t span = max<int64_t>(cfg.maxAmountMinor - cfg.minAmountMinor, 0);
+        w.amount = Money::fromMinor(cfg.minAmountMinor + (int64_t)below((uint64_t)span + 1),
+                                    cfg.openingBalance.currency());
+        if (uniform() < cfg.failureRate) {
+            // refused for one of: an unknown account, a non-positive amount, no funds
+            int unknown = cfg.firstAccount + cfg.accounts;
+            switch (below(w.op == TraceOp::Deposit ? 2 : 3)) {
+            case 0: (w.op == TraceOp::Deposit ? w.toAcc : w.fromAcc) = unknown; break;
+            case 1: w.amount = Money::fromMinor(0, w.amount.currency()); break;
+            default: w.amount = Money::fromMinor(int64_t(1) << 60, w.amount.currency()); break;
+            }
+        }
+        return w;
+    }
+};
+
+namespace workload {
+
+inline TxStatus run(AccountManager& mgr, TraceOp op, int fromAcc, int toAcc, Money amount) {
+    switch (op) {
+    case TraceOp::Transfer: return mgr.tryTransfer(fromAcc, toAcc, amount).status();
+    case TraceOp::Deposit: return mgr.tryDeposit(toAcc, amount).status();
+    case TraceOp::Withdraw: return mgr.tryWithdraw(fromAcc, amount).status();
+    }
+    return TxStatus::InvalidAmount;
+}
+
+// Wait for the scheduled start and return it (now when unpaced)
+inline chrono::steady_clock::time_point pace(chrono::steady_clock::time_point due, bool paced) {
+    if (!paced) return chrono::steady_clock::now();
+    // a sleep overshoots by tens of microseconds: only long gaps are slept, the rest yielded away
+    const auto slack = chrono::microseconds(200);
+    if (due - chrono::steady_clock::now() > slack) this_thread::sleep_until(due - slack / 2);
+    while (chrono::steady_clock::now() < due) this_thread::yield();
+    return due;
+}
+
+inline void count(WorkloadReport& rep, TraceOp op, TxStatus st, uint64_t nanos) {
+    ++rep.operations;
+    ++rep.byOp[(size_t)op];
+    ++rep.byStatus[(size_t)st];
+    rep.latency.record(nanos);
+}
+
+} // namespace workload
+
+// Create the accounts a workload runs over, each with cfg.openingBalance;
+// existing account numbers are left as they are
+inline void seedWorkloadAccounts(AccountManager& mgr, const WorkloadConfig& cfg) {
+    const size_t batch = 1 << 16;
+    vector<BankAccount> accounts;
+    accounts.reserve(min<size_t>(batch, (size_t)max(cfg.accounts, 0)));
+    for (int i = 0; i < cfg.accounts; ++i) {
+        accounts.emplace_back("load" + to_string(i), cfg.firstAccount + i, cfg.openingBalance);
+        if (accounts.size() == batch || i + 1 == cfg.accounts) {
+            mgr.createAccounts(accounts.data(), accounts.size());
+            accounts.clear();
+        }
+    }
+}
+
+// Drive mgr with cfg's workload; the accounts must exist (seedWorkloadAccounts)
+inline WorkloadReport runWorkload(AccountManager& mgr, const WorkloadConfig& cfg) {
+    if (cfg.accounts <= 0 || cfg.transferWeight + cfg.depositWeight + cfg.withdrawWeight == 0)
+        throw invalid_argument("A workload needs accounts and a non-empty operation mix.");
+    ZipfianSampler zipf((uint64_t)cfg.accounts, cfg.zipfSkew);
+    unsigned threads = max(1u, cfg.threads);
+    bool paced = cfg.targetRate > 0;
+    chrono::nanoseconds interval(paced ? (int64_t)(1e9 * threads / cfg.targetRate) : 0);
+    vector<WorkloadReport> parts(threads);
+    auto t0 = chrono::steady_clock::now();
+    auto body = [&](unsigned k) {
+        WorkloadGenerator gen(cfg, zipf, k);
+        size_t ops = cfg.operations / threads + (k < cfg.operations % threads ? 1 : 0);
+        auto due = t0;
+        for (size_t i = 0; i < ops; ++i, due += interval) {
+            WorkloadOp w = gen.next();
+            auto start = workload::pace(due, paced);
+            TxStatus st = workload::run(mgr, w.op, w.fromAcc, w.toAcc, w.amount);
+            workload::count(parts[k], w.op, st, nanosSince(start));
+        }
+    };
+    vector<thread> pool;
+    for (unsigned k = 1; k < threads; ++k) pool.emplace_back(body, k);
+    body(0);
+    for (thread& t : pool) t.join();
+
+    WorkloadReport rep;
+    rep.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    for (const WorkloadReport& p : parts) {
+        rep.operations += p.operations;
+        for (size_t k = 0; k < traceOpCount; ++k) rep.byOp[k] += p.byOp[k];
+        for (size_t s = 0; s < txStatusCount; ++s) rep.byStatus[s] += p.byStatus[s];
+        rep.latency.merge(p.latency);
+    }
+    return rep;
+}
+
+// Run a captured trace against mgr, one operation at a time in trace order,
+// as fast as possible or (paced) at the trace's own timing. On the accounts
+// the capture started from, a single-threaded capture is reproduced exactly;
+// statusMismatches counts the operations that came out differently.
+inline WorkloadReport replayTrace(AccountManager& mgr, const string& tracePath, bool paced = false) {
+    TraceReader trace(tracePath);
+    WorkloadReport rep;
+    auto t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.size(); ++i) {
+        TraceRecord r = trace[i];
+        if (r.op >= traceOpCount) throw runtime_error("Trace file " + tracePath + " holds an unknown operation.");
+        auto start = workload::pace(t0 + chrono::nanoseconds(r.atNanos), paced);
+        TxStatus st = workload::run(mgr, r.kind(), r.fromAcc, r.toAcc, r.amount());
+        workload::count(rep, r.kind(), st, nanosSince(start));
+        if ((uint8_t)st != r.status) ++rep.statusMismatches;
+    }
+    rep.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    return rep;
+}
+
+// --------------------------- 7) UTILITY FUNCTION (pass/return objects) ----------
+BankAccount giveSignupBonus(BankAccount acc) {
+    // Example of object passed & returned
+    acc.updateBalance(100.0); // bonus
+    return acc;
+}
+
+// --------------------------- 8) MAIN: demonstration & simple menu ---------------
+#ifndef BANK_BENCH
+int main() {
+    AccountManager mgr;
+    try {
+        cout << "=== Bank Account & Transaction System (Demo) ===\n\n";
+        const LoadStats& loaded = mgr.loadStats();
+        if (loaded.accountLinesSkipped + loaded.logLinesSkipped > 0)
+            cout << "[Warn] Skipped " << loaded.accountLinesSkipped << " malformed account line(s) and "
+                 << loaded.logLinesSkipped << " malformed log line(s) while loading.\n\n";
+
+        // 1) Create sample accounts and persist them
+        cout << "[Demo] Creating sample accounts (Alice, Bob)...\n";
+        BankAccount a1("Alice", 1001, 1500.0);
+        BankAccount a2("Bob",   1002, 800.0);
+
+        // Save to file (one log append; accounts left from an earlier run are kept)
+        for (int dup : mgr.createAccounts({a1, a2}))
+            cout << "[Demo] Account " << dup << " already exists; keeping it.\n";
+
+        // 2) Display (abstract override + operator<<)
+        cout << "\n[Demo] Displaying created accounts:\n";
+        a1.display();
+        a2.display();
+
+        // 3) Operator overloading deposit and withdraw
+        cout << "\n[Demo] Depositing 200 to Alice using operator+ ...\n";
+        a1 = a1 + 200.0; // operator+
+        cout << a1 << "\n";
+
+        cout << "[Demo] Withdrawing 100 from Alice using updateBalance(withdraw)...\n";
+        a1.updateBalance(100.0, true);
+        cout << a1 << "\n";
+
+        // 4) Return-by-reference demo
+        Money &refBal = a1.getBalanceRef();  // return by reference
+        refBal += 25.0;                       // directly update using reference
+        cout << "[Demo] After modifying via returned reference: " << a1 << "\n";
+
+        // 5) Template usage
+        double matured = calculateMatured<double>(1000.0, 5.0, 2); // simple interest
+        cout << "[Demo] Template function calculateMatured: 1000 at 5% for 2 years -> " << matured << "\n";
+        Money maturedExact = calculateMatured<Money>(Money(1000.0), 5.0, 2); // exact fixed-point
+        cout << "[Demo] Specialised for Money: " << maturedExact << "\n";
+
+        // 6) Process account via object pass & return
+        cout << "[Demo] Applying signup bonus to Bob (object pass/return)...\n";
+        a2 = giveSignupBonus(std::move(a2)); // moved in and out, no copy
+        cout << a2 << "\n";
+
+        // 7) Write updated single-account objects (only changed records are written)
+        vector<BankAccount> all = mgr.loadAllAccounts();
+        // update entries in file to reflect modified balances for demo
+        for (auto &acc : all) {
+            if (acc.getAccNumber() == a1.getAccNumber()) acc = a1;
+            if (acc.getAccNumber() == a2.getAccNumber()) acc = a2;
+        }
+        mgr.saveAllAccounts(all);
+
+        // 8) Perform a transfer using AccountManager (file-backed)
+        cout << "\n[Demo] Transfer 200 from Alice (1001) to Bob (1002)...\n";
+        bool t = mgr.transferFunds(1001, 1002, 200.0);
+        if (t) cout << "[Demo] Transfer successful and files updated.\n";
+
+        // 8a) Non-throwing API: a refused transfer is just a status
+        Result<void> refused = mgr.tryTransfer(1002, 1001, 1.0e6);
+        cout << "[Demo] tryTransfer of 1,000,000 from Bob: " << statusMessage(refused.status()) << "\n";
+
+        // 8b) Batch transfer: one commit, one status per row instead of exceptions
+        cout << "[Demo] Batch of three transfers (the last one overdraws Bob)...\n";
+        vector<TransferRequest> batch = {{1002, 1001, 50.0}, {1001, 1002, 25.0}, {1002, 1001, 1.0e6}};
+        vector<TxStatus> outcome = mgr.transferBatch(batch);
+        for (size_t i = 0; i < outcome.size(); ++i)
+            cout << "  row " << i << ": " << statusMessage(outcome[i]) << "\n";
+
+        // 8c) Statement: newest log entries for one account via the history index
+        cout << "[Demo] Last 3 log entries for Alice:\n";
+        Result<vector<Transaction>> recent = mgr.recentTransactions(1001, 3);
+        for (const Transaction& tx : recent.value())
+            cout << "  " << tx.getFromAcc() << " -> " << tx.getToAcc() << "  " << tx.getAmount()
+                 << "  " << tx.getNote() << "\n";
+
+        // 8d) Asynchronous submission: the caller gets futures, an applier thread does the work
+        {
+            TransferQueue queue(mgr);
+            future<TxStatus> there = queue.submit(1001, 1002, 10.0);
+            future<TxStatus> back = queue.submit(1002, 1001, 10.0);
+            cout << "[Demo] Queued transfers: " << statusMessage(there.get()) << ", "
+                 << statusMessage(back.get()) << " (" << queue.metrics().batches << " batch(es))\n";
+        }
+
+        // 9) Exception handling demo: attempted invalid withdrawal
+        try {
+            cout << "\n[Demo] Attempting invalid withdrawal (-50) to demonstrate exception handling...\n";
+            a1.updateBalance(-50.0);
+        } catch (const exception &e) {
+            cerr << "[Caught Exception] " << e.what() << "\n";
+        }
+
+        // 10) Show file-backed accounts now
+        cout << "\n[Demo] Final accounts loaded from file:\n";
+        vector<BankAccount> finalList = mgr.loadAllAccounts();
+        for (const auto &x : finalList) x.display();
+
+        MetricsSnapshot ms = mgr.metricsSnapshot();
+        cout << "\n[Demo] Transfers applied: " << ms.transfersApplied << ", rejected: " << ms.transfersRejectedTotal()
+             << ", median transfer latency: " << ms.transfer.percentile(0.5) / 1000.0 << " us\n";
+
+        cout << "\n=== Demo finished successfully ===\n";
+    } catch (const exception &e) {
+        cerr << "[Unhandled Exception] " << e.what() << "\n";
+    }
+    return 0;
+}
+#endif
+
+// --------------------------- 9) BENCHMARKS (-DBANK_BENCH) -----------------------
+// Build: g++ -std=c++17 -O2 -pthread -DBANK_BENCH bank_full_system.cpp -o bank_bench
+// Run:   ./bank_bench [opsPerThread] [scanAccounts] [--json FILE] [--load-sizes N,N,...] [--only NAME,...]
+// Every benchmark works on its own scratch directory under /tmp. Results are
+// printed as tables; --json also writes them as one JSON document (one result
+// per line) to diff against the numbers of a baseline release.
+#ifdef BANK_BENCH
+#include <filesystem>
+
+// Every heap allocation in the benchmark binary goes through here: all the
+// replaceable forms of operator new (array, nothrow, aligned) are counted
+static atomic<size_t> heapAllocations{0};
+
+static void* countedAlloc(size_t n, size_t align = 0) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (n == 0) n = 1;
+    if (align > alignof(max_align_t)) return aligned_alloc(align, (n + align - 1) / align * align);
+    return malloc(n);
+}
+
+static void* countedNew(size_t n, size_t align = 0) {
+    if (void* p = countedAlloc(n, align)) return p;
+    throw bad_alloc();
+}
+
+void* operator new(size_t n) { return countedNew(n); }
+void* operator new[](size_t n) { return countedNew(n); }
+void* operator new(size_t n, const nothrow_t&) noexcept { return countedAlloc(n); }
+void* operator new[](size_t n, const nothrow_t&) noexcept { return countedAlloc(n); }
+void* operator new(size_t n, align_val_t a) { return countedNew(n, (size_t)a); }
+void* operator new[](size_t n, align_val_t a) { return countedNew(n, (size_t)a); }
+void* operator new(size_t n, align_val_t a, const nothrow_t&) noexcept { return countedAlloc(n, (size_t)a); }
+void* operator new[](size_t n, align_val_t a, const nothrow_t&) noexcept { return countedAlloc(n, (size_t)a); }
+// (the replaced operator new allocates with malloc; GCC cannot see that)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+
+namespace bench {
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point t0) {
+    return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// "1 thread", "4 threads": the one label style for rows and report keys
+static string threadsLabel(unsigned n) { return to_string(n) + (n == 1 ? " thread" : " threads"); }
+
+// Every number a benchmark prints, for --json
+class Report {
+private:
+    struct Entry {
+        string benchmark;
+        string metric;
+        double value;
+        string unit;
+    };
+    vector<Entry> entries;
+
+    static string quoted(const string& s) {
+        string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+public:
+    void add(const string& benchmark, const string& metric, double value, const string& unit) {
+        entries.push_back({benchmark, metric, value, unit});
+    }
+
+    void writeJson(const string& path) const {
+        string out = "{\n  \"schema\": 1,\n";
+        out += "  \"compiler\": " + quoted(__VERSION__) + ",\n";
+#if defined(__AVX2__)
+        out += "  \"avx2\": true,\n";
+#else
+        out += "  \"avx2\": false,\n";
+#endif
+        out += "  \"hardwareThreads\": " + to_string(thread::hardware_concurrency()) + ",\n";
+        out += "  \"unixTime\": " + to_string(chrono::duration_cast<chrono::seconds>(
+                   chrono::system_clock::now().time_since_epoch()).count()) + ",\n";
+        out += "  \"results\": [\n";
+        char num[32];
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const Entry& e = entries[i];
+            snprintf(num, sizeof num, "%.6g", e.value);
+            out += "    {\"benchmark\": " + quoted(e.benchmark) + ", \"metric\": " + quoted(e.metric) +
+                   ", \"value\": " + num + ", \"unit\": " + quoted(e.unit) + "}" +
+                   (i + 1 < entries.size() ? ",\n" : "\n");
+        }
+        out += "  ]\n}\n";
+        writeFileAtomically(path, out);
+    }
+};
+
+static Report report;
+
+// Scratch directory removed on scope exit
+class TempDir {
+private:
+    string dir;
+public:
+    TempDir() {
+        char tmpl[] = "/tmp/bankbench.XXXXXX";
+        if (!::mkdtemp(tmpl)) throw runtime_error("Unable to create a scratch directory.");
+        dir = tmpl;
+    }
+    ~TempDir() {
+        error_code ec;
+        filesystem::remove_all(dir, ec);
+    }
+    string file(const string& name) const { return dir + "/" + name; }
+
+    AccountManagerConfig config(Durability d = Durability::Buffered) const {
+        AccountManagerConfig cfg;
+        cfg.snapshotFile = file("accounts.dat");
+        cfg.accountsFile = file("accounts.txt");
+        cfg.transactionsFile = file("transactions.txt");
+        cfg.historyIndexFile = file("transactions.idx");
+        cfg.durability = d;
+        return cfg;
+    }
+};
+
+// Each thread moves money back and forth inside its own pair of accounts, so
+// the only shared state is the transaction log
+static void transferScaling(int opsPerThread) {
+    const vector<int> threadCounts = {1, 2, 4, 8, 16, 32, 64};
+    const int maxThreads = threadCounts.back();
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    for (int t = 0; t < maxThreads; ++t) {
+        mgr.createAccount(BankAccount("bench", 2 * t + 1, Money(1e9)));
+        mgr.createAccount(BankAccount("bench", 2 * t + 2, Money(1e9)));
+    }
+
+    printf("tryTransfer, disjoint account pairs, %d ops/thread (hardware: %s)\n", opsPerThread,
+           threadsLabel(max(1u, thread::hardware_concurrency())).c_str());
+    printf("%8s %16s %10s\n", "threads", "transfers/s", "speedup");
+    double base = 0;
+    for (int n : threadCounts) {
+        atomic<bool> go{false};
+        vector<thread> workers;
+        for (int t = 0; t < n; ++t) {
+            workers.emplace_back([&, t] {
+                int a = 2 * t + 1, b = 2 * t + 2;
+                while (!go.load(memory_order_acquire)) this_thread::yield();
+                for (int k = 0; k < opsPerThread; ++k) {
+                    if (k & 1) mgr.tryTransfer(a, b, Money::fromMinor(1));
+                    else mgr.tryTransfer(b, a, Money::fromMinor(1));
+                }
+            });
+        }
+        Clock::time_point t0 = Clock::now();
+        go.store(true, memory_order_release);
+        for (auto& w : workers) w.join();
+        double rate = (double)n * opsPerThread / secondsSince(t0);
+        if (base == 0) base = rate;
+        printf("%8d %16.0f %9.2fx\n", n, rate, rate / base);
+        report.add("transfer_scaling", threadsLabel((unsigned)n), rate, "transfers/s");
+    }
+}
+
+// Total/min/max/overdrawn scans: columnar kernels vs. walking BankAccount objects
+static void balanceScans(size_t n) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    {
+        vector<BankAccount> seed;
+        seed.reserve(n);
+        uint64_t x = 88172645463325252ull;            // xorshift: reproducible balances
+        for (size_t i = 0; i < n; ++i) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            seed.emplace_back("customer", (int)i + 1, Money::fromMinor((int64_t)(x % 2000000) - 100000));
+        }
+        mgr.saveAllAccounts(seed);
+    }
+
+    auto scanObjects = [](const vector<BankAccount>& list) {
+        int64_t total = 0, lo = numeric_limits<int64_t>::max(), hi = numeric_limits<int64_t>::min();
+        size_t overdrawn = 0;
+        for (const auto& a : list) {
+            int64_t b = a.getBalanceConstRef().minorUnits();
+            total += b;
+            lo = min(lo, b);
+            hi = max(hi, b);
+            overdrawn += b < 0;
+        }
+        return total + lo + hi + (int64_t)overdrawn;   // keep the loop alive
+    };
+
+    Clock::time_point t0 = Clock::now();
+    int64_t sink = scanObjects(mgr.loadAllAccounts());
+    double viaLoad = secondsSince(t0);
+
+    vector<BankAccount> resident = mgr.loadAllAccounts();
+    t0 = Clock::now();
+    sink += scanObjects(resident);
+    double viaObjects = secondsSince(t0);
+
+    t0 = Clock::now();
+    AccountManager::BalanceStats st = mgr.balanceStats();
+    size_t overdrawn = mgr.accountsBelow(Money()).size();
+    double viaColumn = secondsSince(t0);
+    sink += st.total.minorUnits() + (int64_t)overdrawn;
+
+#if defined(__AVX2__)
+    const char* isa = "AVX2";
+#else
+    const char* isa = "scalar";
+#endif
+    printf("\nbalance scans over %zu accounts (sum/min/max/overdrawn, %s kernels)\n", n, isa);
+    printf("  loadAllAccounts() + object loop %10.2f ms\n", viaLoad * 1e3);
+    printf("  object loop only                %10.2f ms\n", viaObjects * 1e3);
+    printf("  balance column kernels          %10.2f ms  (%.1fx / %.1fx)\n", viaColumn * 1e3,
+           viaLoad / viaColumn, viaObjects / viaColumn);
+    report.add("balance_scans", "loadAllAccounts + object loop", viaLoad * 1e3, "ms");
+    report.add("balance_scans", "object loop", viaObjects * 1e3, "ms");
+    report.add("balance_scans", "column kernels", viaColumn * 1e3, "ms");
+    if (sink == 42) printf(" ");
+}
+
+// Checkpoint after a handful of transfers: a full snapshot rewrite vs. the
+// in-place patch of the changed records
+static void checkpointCost(size_t n) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    {
+        vector<BankAccount> seed;
+        seed.reserve(n);
+        for (size_t i = 0; i < n; ++i) seed.emplace_back("customer", (int)i + 1, Money(1000.0));
+        mgr.saveAllAccounts(seed);
+    }
+    const int transfers = 16;
+    auto touch = [&] {
+        for (int k = 0; k < transfers; ++k)
+            mgr.tryTransfer((int)((size_t)k * 7919 % n) + 1, (int)((size_t)k * 104729 % n) + 1, Money(1.0));
+    };
+    string snapshot = dir.file("accounts.dat");
+
+    touch();
+    vector<BankAccount> all = mgr.loadAllAccounts();
+    all.push_back(BankAccount("extra", (int)n + 1, Money(1.0)));  // a new account forces a rewrite
+    Clock::time_point t0 = Clock::now();
+    mgr.saveAllAccounts(all);
+    double fullSecs = secondsSince(t0);
+    uint64_t fullBytes = fileSize(snapshot);
+
+    touch();
+    t0 = Clock::now();
+    mgr.checkpoint();
+    double patchSecs = secondsSince(t0);
+    uint64_t patchBytes = sizeof(AccountJournalHeader) + 2 * transfers * sizeof(AccountJournalEntry) +
+                          sizeof(uint64_t) + 2 * transfers * sizeof(AccountRecord);   // upper bound
+
+    printf("\ncheckpoint of %zu accounts after %d transfers\n", n, transfers);
+    printf("  %-34s %10.2f ms %12llu bytes\n", "full snapshot rewrite", fullSecs * 1e3, (unsigned long long)fullBytes);
+    printf("  %-34s %10.2f ms %12llu bytes (at most)\n", "journaled in-place patch", patchSecs * 1e3,
+           (unsigned long long)patchBytes);
+    report.add("checkpoint", "full rewrite", fullSecs * 1e3, "ms");
+    report.add("checkpoint", "in-place patch", patchSecs * 1e3, "ms");
+}
+
+// ShardedAccountManager: transfers that stay inside a shard vs. ones that
+// cross shards (three messages passed shard to shard, three log records)
+static void shardedTransfers(int opsPerThread) {
+    TempDir dir;
+    ShardedAccountConfig cfg;
+    cfg.directory = dir.file("");
+    cfg.durability = Durability::Buffered;
+    ShardedAccountManager mgr(cfg);
+    const int threads = 8;
+    vector<pair<int, int>> local, remote;      // per thread: a same-shard and a cross-shard pair
+    vector<int> spare;                         // numbers not in a pair yet; pairs never overlap
+    for (int acc = 1; (int)local.size() < threads || (int)remote.size() < threads; ++acc) {
+        bool paired = false;
+        for (size_t i = 0; i < spare.size() && !paired; ++i) {
+            vector<pair<int, int>>& pairs = mgr.shardOf(acc) == mgr.shardOf(spare[i]) ? local : remote;
+            if ((int)pairs.size() < threads) {
+                pairs.push_back({spare[i], acc});
+                spare.erase(spare.begin() + (ptrdiff_t)i);
+                paired = true;
+            }
+        }
+        if (!paired) spare.push_back(acc);
+    }
+    for (auto* pairs : {&local, &remote})
+        for (auto& p : *pairs) {
+            mgr.createAccount(BankAccount("bench", p.first, Money(1e9)));
+            mgr.createAccount(BankAccount("bench", p.second, Money(1e9)));
+        }
+
+    printf("\nShardedAccountManager (%zu shards), %d threads x %d transfers\n", mgr.shardCount(), threads,
+           opsPerThread);
+    for (auto* pairs : {&local, &remote}) {
+        Clock::time_point t0 = Clock::now();
+        vector<thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                int a = (*pairs)[t].first, b = (*pairs)[t].second;
+                for (int k = 0; k < opsPerThread; ++k) {
+                    if (k & 1) mgr.tryTransfer(a, b, Money::fromMinor(1));
+                    else mgr.tryTransfer(b, a, Money::fromMinor(1));
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+        double rate = (double)threads * opsPerThread / secondsSince(t0);
+        const char* kind = pairs == &local ? "same-shard" : "cross-shard (two-phase)";
+        printf("  %-34s %12.0f transfers/s\n", kind, rate);
+        report.add("sharded_transfers", kind, rate, "transfers/s");
+    }
+}
+
+// Submitting through TransferQueue: how long producers wait per transfer,
+// and the end-to-end rate until every future is ready
+static void queueSubmission(int opsPerThread) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    const int producers = 8;
+    for (int a = 1; a <= 2 * producers; ++a) mgr.createAccount(BankAccount("bench", a, Money(1e9)));
+
+    printf("\nTransferQueue, %d producers x %d transfers\n", producers, opsPerThread);
+    printf("%9s %8s %14s %16s %10s %10s\n", "appliers", "policy", "submit ns/op", "transfers/s", "rejected", "batches");
+    for (unsigned appliers : {1u, 2u, 4u}) {
+        for (bool block : {true, false}) {
+            TransferQueueConfig qc;
+            qc.appliers = appliers;
+            qc.blockWhenFull = block;
+            TransferQueue queue(mgr, qc);
+            atomic<int64_t> submitNanos{0};
+            Clock::time_point t0 = Clock::now();
+            vector<thread> workers;
+            for (int t = 0; t < producers; ++t) {
+                workers.emplace_back([&, t] {
+                    vector<future<TxStatus>> outcomes;
+                    outcomes.reserve(opsPerThread);
+                    Clock::time_point s0 = Clock::now();
+                    for (int k = 0; k < opsPerThread; ++k)
+                        outcomes.push_back(k & 1 ? queue.submit(2 * t + 1, 2 * t + 2, Money::fromMinor(1))
+                                                 : queue.submit(2 * t + 2, 2 * t + 1, Money::fromMinor(1)));
+                    submitNanos += chrono::duration_cast<chrono::nanoseconds>(Clock::now() - s0).count();
+                    for (auto& f : outcomes) f.get();
+                });
+            }
+            for (auto& w : workers) w.join();
+            double secs = secondsSince(t0);
+            TransferQueueMetrics m = queue.metrics();
+            double submitNs = (double)submitNanos.load() / ((double)producers * opsPerThread);
+            printf("%9u %8s %14.0f %16.0f %10llu %10llu\n", appliers, block ? "block" : "reject",
+                   submitNs, (double)m.applied / secs, (unsigned long long)m.rejected, (unsigned long long)m.batches);
+            string config = to_string(appliers) + " appliers, " + (block ? "block" : "reject");
+            report.add("transfer_queue", config + ", submit", submitNs, "ns/op");
+            report.add("transfer_queue", config + ", applied", (double)m.applied / secs, "transfers/s");
+        }
+    }
+}
+
+// "Last 10 records of one account": scanning the whole log vs. the index
+static void historyLookup(size_t records) {
+    TempDir dir;
+    AccountManagerConfig cfg = dir.config();
+    const int accounts = 1000;
+    {
+        AccountManager mgr(cfg);
+        for (int a = 1; a <= accounts; ++a) mgr.createAccount(BankAccount("customer", a, Money(1e9)));
+        vector<TransferRequest> batch;
+        for (size_t i = 0; i < records; ++i) {
+            batch.push_back({(int)(i * 7919 % accounts) + 1, (int)(i * 104729 % accounts) + 1, Money(1.0)});
+            if (batch.size() == 4096 || i + 1 == records) {
+                mgr.transferBatch(batch);
+                batch.clear();
+            }
+        }
+    }
+    AccountManager mgr(cfg);
+    const int acc = 42;
+    const size_t n = 10;
+
+    Clock::time_point t0 = Clock::now();
+    vector<Transaction> ring;                      // what a statement had to do before
+    {
+        TransactionLogReader reader(cfg.transactionsFile);
+        Transaction tx;
+        uint64_t at;
+        while (reader.next(tx, at)) {
+            if (tx.getFromAcc() != acc && tx.getToAcc() != acc) continue;
+            ring.push_back(tx);
+            if (ring.size() > n) ring.erase(ring.begin());
+        }
+    }
+    double scanSecs = secondsSince(t0);
+
+    t0 = Clock::now();
+    size_t built = mgr.recentTransactions(acc, n).value().size();   // first query builds the index
+    double buildSecs = secondsSince(t0);
+    t0 = Clock::now();
+    size_t found = mgr.recentTransactions(acc, n).value().size();
+    double lookupSecs = secondsSince(t0);
+
+    printf("\nlast %zu records of one account, %zu-record log\n", n, records);
+    printf("  %-34s %10.3f ms %6zu found\n", "full log scan", scanSecs * 1e3, ring.size());
+    printf("  %-34s %10.3f ms %6zu found\n", "index (first query builds it)", buildSecs * 1e3, built);
+    printf("  %-34s %10.3f ms %6zu found\n", "index lookup", lookupSecs * 1e3, found);
+    report.add("history", "full log scan", scanSecs * 1e3, "ms");
+    report.add("history", "index build", buildSecs * 1e3, "ms");
+    report.add("history", "index lookup", lookupSecs * 1e3, "ms");
+}
+
+// One month of 6% simple interest: per-account calculateMatured/updateBalance
+// plus saveAllAccounts vs. accrueInterest
+static void interestAccrual(size_t n) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    {
+        vector<BankAccount> seed;
+        seed.reserve(n);
+        for (size_t i = 0; i < n; ++i) seed.emplace_back("customer", (int)i + 1, Money::fromMinor((int64_t)(i * 7919 % 10000000)));
+        mgr.saveAllAccounts(seed);
+    }
+    InterestPlan plan;
+    plan.defaultRatePercent = 6;
+
+    Clock::time_point t0 = Clock::now();
+    {
+        vector<BankAccount> all = mgr.loadAllAccounts();
+        for (auto& a : all) {
+            Money bal = a.getBalanceConstRef();
+            if (bal.isPositive()) a.updateBalance(calculateMatured<Money>(bal, 6.0 / 12, 1) - bal);
+        }
+        mgr.saveAllAccounts(all);
+    }
+    double perAccount = secondsSince(t0);
+
+    unsigned hw = max(1u, thread::hardware_concurrency());
+    t0 = Clock::now();
+    mgr.accrueInterest(plan, 1);
+    double batch1 = secondsSince(t0);
+    double batchN = 0;
+    if (hw > 1) {
+        t0 = Clock::now();
+        mgr.accrueInterest(plan, hw);
+        batchN = secondsSince(t0);
+    }
+
+#if defined(__AVX2__)
+    const char* isa = "AVX2";
+#else
+    const char* isa = "scalar";
+#endif
+    printf("\nmonthly interest on %zu accounts (%s kernel), including the log append\n", n, isa);
+    printf("  %-34s %10.2f ms\n", "updateBalance per account + save", perAccount * 1e3);
+    printf("  %-34s %10.2f ms\n", "accrueInterest, 1 thread", batch1 * 1e3);
+    report.add("interest", "per-account updateBalance + save", perAccount * 1e3, "ms");
+    report.add("interest", "accrueInterest, 1 thread", batch1 * 1e3, "ms");
+    if (hw > 1) {
+        string label = "accrueInterest, " + threadsLabel(hw);
+        printf("  %-34s %10.2f ms\n", label.c_str(), batchN * 1e3);
+        report.add("interest", label, batchN * 1e3, "ms");
+    }
+}
+
+// The original BankAccount::fromRecord: substr temporaries, stoi, stod
+static BankAccount legacyFromRecord(const string& rec) {
+    size_t p1 = rec.find('|');
+    size_t p2 = rec.find('|', p1 + 1);
+    string n = rec.substr(0, p1);
+    int acc = stoi(rec.substr(p1 + 1, p2 - (p1 + 1)));
+    double bal = stod(rec.substr(p2 + 1));
+    return BankAccount(n, acc, Money(bal));
+}
+
+// The original loadAllAccounts loop (getline + legacy parse + vector growth)
+// vs. the mapped string_view parser filling a pre-sized AccountTable
+static void textLoad(size_t n) {
+    TempDir dir;
+    string path = dir.file("accounts.txt");
+    {
+        ofstream ofs(path);
+        for (size_t i = 0; i < n; ++i)
+            ofs << "customer account holder " << i << "|" << i + 1 << "|"
+                << Money::fromMinor((int64_t)(i * 7919 % 10000000)) << "\n";
+    }
+
+    size_t a0 = heapAllocations.load();
+    Clock::time_point t0 = Clock::now();
+    {
+        vector<BankAccount> list;
+        ifstream ifs(path);
+        string line;
+        while (getline(ifs, line)) {
+            if (line.empty()) continue;
+            try {
+                BankAccount a = legacyFromRecord(line);
+                list.push_back(a);
+            } catch (...) {
+            }
+        }
+    }
+    double legacySecs = secondsSince(t0);
+    size_t legacyAllocs = heapAllocations.load() - a0;
+
+    a0 = heapAllocations.load();
+    t0 = Clock::now();
+    size_t loaded;
+    {
+        AccountTable table;
+        uint64_t covered = 0;
+        loadLegacyAccountText(path, table, covered);
+        loaded = table.size();
+    }
+    double bulkSecs = secondsSince(t0);
+    size_t bulkAllocs = heapAllocations.load() - a0;
+
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    t0 = Clock::now();
+    LoadStats stats;
+    {
+        AccountTable table;
+        uint64_t covered = 0;
+        stats = loadLegacyAccountText(path, table, covered, threads);
+    }
+    double parallelSecs = secondsSince(t0);
+
+    printf("\ntext account load, %zu records (%zu loaded)\n", n, loaded);
+    printf("  %-34s %10.2f ms %12zu allocs %8.3f allocs/record\n", "getline + substr/stod + vector",
+           legacySecs * 1e3, legacyAllocs, (double)legacyAllocs / n);
+    printf("  %-34s %10.2f ms %12zu allocs %8.3f allocs/record\n", "mapped parse into AccountTable",
+           bulkSecs * 1e3, bulkAllocs, (double)bulkAllocs / n);
+    printf("  %-26s %2u thr %10.2f ms %12zu records %6zu skipped\n", "chunked parallel parse",
+           threads, parallelSecs * 1e3, stats.accountsLoaded, stats.accountLinesSkipped);
+    report.add("text_load", "getline + substr/stod", legacySecs * 1e3, "ms");
+    report.add("text_load", "mapped parse", bulkSecs * 1e3, "ms");
+    report.add("text_load", "mapped parse", (double)bulkAllocs / n, "allocs/record");
+    report.add("text_load", "chunked parallel parse", parallelSecs * 1e3, "ms");
+}
+
+// BankAccount and Transaction record parse/format rates
+static void recordCodec(size_t n) {
+    vector<BankAccount> accounts;
+    vector<Transaction> txs;
+    accounts.reserve(n);
+    txs.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        accounts.emplace_back("customer account holder " + to_string(i), (int)i + 1,
+                              Money::fromMinor((int64_t)(i * 7919 % 100000000)));
+        txs.emplace_back((int)i + 1, (int)(n - i), Money::fromMinor((int64_t)(i * 104729 % 1000000)), "transfer");
+    }
+    vector<string> accountRecs(n), txRecs(n);
+
+    auto rate = [&](const char* metric, auto&& op) {
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) op(i);
+        double r = (double)n / secondsSince(t0);
+        printf("  %-34s %14.0f records/s\n", metric, r);
+        report.add("record_codec", metric, r, "records/s");
+    };
+    size_t sink = 0;
+    string arena;              // one reused output buffer, as the log writer uses it
+    printf("\nrecord parse/format, %zu records\n", n);
+    rate("to_string + operator+ (baseline)", [&](size_t i) {
+        const Transaction& t = txs[i];
+        sink += (to_string(t.getFromAcc()) + "|" + to_string(t.getToAcc()) + "|" + t.getAmount().toString() + "|" +
+                 t.getNote() + "\n").size();
+    });
+    rate("Transaction::appendRecord", [&](size_t i) {
+        if (arena.size() > (1 << 20)) arena.clear();
+        txs[i].appendRecord(arena);
+    });
+    rate("BankAccount::appendRecord", [&](size_t i) {
+        if (arena.size() > (1 << 20)) arena.clear();
+        BankAccount::appendRecord(arena, accounts[i].getName(), accounts[i].getAccNumber(),
+                                  accounts[i].getBalanceConstRef());
+    });
+    // records are parsed as lines, without the trailing newline
+    rate("BankAccount::toRecord", [&](size_t i) { accountRecs[i] = accounts[i].toRecord(); accountRecs[i].pop_back(); });
+    rate("BankAccount::fromRecord", [&](size_t i) { sink += BankAccount::fromRecord(accountRecs[i]).getAccNumber(); });
+    rate("Transaction::toRecord", [&](size_t i) { txRecs[i] = txs[i].toRecord(); txRecs[i].pop_back(); });
+    rate("Transaction::fromRecord", [&](size_t i) { sink += Transaction::fromRecord(txRecs[i]).getToAcc(); });
+    if (sink == 42) printf(" ");
+}
+
+// Cold start (map the snapshot into the table) and loadAllAccounts at each size
+static void loadScaling(const vector<size_t>& sizes) {
+    printf("\naccount load\n%12s %14s %18s\n", "accounts", "open ms", "loadAllAccounts ms");
+    for (size_t n : sizes) {
+        TempDir dir;
+        AccountManagerConfig cfg = dir.config();
+        {
+            AccountTable seed;
+            seed.reserve(n);
+            seed.reserveNames(1);
+            for (size_t i = 0; i < n; ++i) seed.upsert((int)i + 1, "customer", Money::fromMinor((int64_t)(i % 1000000)));
+            writeFileAtomically(cfg.snapshotFile, encodeAccountFile(seed, 0));
+        }
+        Clock::time_point t0 = Clock::now();
+        AccountManager mgr(cfg);
+        double openSecs = secondsSince(t0);
+        t0 = Clock::now();
+        size_t loaded = mgr.loadAllAccounts().size();
+        double loadSecs = secondsSince(t0);
+        if (loaded != n) throw runtime_error("Account load returned the wrong count.");
+        printf("%12zu %14.2f %18.2f\n", n, openSecs * 1e3, loadSecs * 1e3);
+        report.add("account_load", to_string(n) + " accounts, open", openSecs * 1e3, "ms");
+        report.add("account_load", to_string(n) + " accounts, loadAllAccounts", loadSecs * 1e3, "ms");
+    }
+}
+
+// Latency distribution of single transferFunds calls on one thread
+static void transferLatency(int ops) {
+    printf("\ntransferFunds latency (us)\n%10s %8s %8s %8s %8s %8s %8s\n", "mode", "ops", "p50", "p90", "p99",
+           "p99.9", "max");
+    for (Durability d : {Durability::Buffered, Durability::Durable}) {
+        TempDir dir;
+        AccountManager mgr(dir.config(d));
+        mgr.createAccount(BankAccount("bench", 1, Money(1e9)));
+        mgr.createAccount(BankAccount("bench", 2, Money(1e9)));
+        int n = d == Durability::Durable ? min(ops, 2000) : ops;   // one fsync each
+        vector<double> micros;
+        micros.reserve(n);
+        for (int k = 0; k < n; ++k) {
+            Clock::time_point t0 = Clock::now();
+            mgr.transferFunds(k & 1 ? 1 : 2, k & 1 ? 2 : 1, Money::fromMinor(1));
+            micros.push_back(secondsSince(t0) * 1e6);
+        }
+        sort(micros.begin(), micros.end());
+        auto at = [&](double q) { return micros[min(micros.size() - 1, (size_t)(q * micros.size()))]; };
+        const char* mode = d == Durability::Durable ? "durable" : "buffered";
+        printf("%10s %8d %8.1f %8.1f %8.1f %8.1f %8.1f\n", mode, n, at(0.50), at(0.90), at(0.99), at(0.999),
+               micros.back());
+        const pair<const char*, double> points[] = {{"p50", at(0.50)}, {"p90", at(0.90)}, {"p99", at(0.99)},
+                                                    {"p99.9", at(0.999)}, {"max", micros.back()}};
+        for (const auto& p : points) report.add("transfer_latency", string(mode) + " " + p.first, p.second, "us");
+    }
+}
+
+// Finding an account: findAccountIndex's linear scan vs. the hash index
+static void lookupCost(size_t n) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    {
+        vector<BankAccount> seed;
+        seed.reserve(n);
+        for (size_t i = 0; i < n; ++i) seed.emplace_back("customer", (int)i + 1, Money(100.0));
+        mgr.saveAllAccounts(seed);
+    }
+    vector<BankAccount> list = mgr.loadAllAccounts();
+    size_t linearLookups = max<size_t>(1, min<size_t>(n, 2000000000 / max<size_t>(n, 1) / 100));
+    size_t indexLookups = 1000000;
+    uint64_t x = 88172645463325252ull;
+    auto nextAcc = [&] {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        return (int)(x % n) + 1;
+    };
+
+    int64_t sink = 0;
+    Clock::time_point t0 = Clock::now();
+    for (size_t k = 0; k < linearLookups; ++k) sink += mgr.findAccountIndex(list, nextAcc());
+    double linearNs = secondsSince(t0) * 1e9 / linearLookups;
+    t0 = Clock::now();
+    for (size_t k = 0; k < indexLookups; ++k) sink += mgr.balanceOf(nextAcc()).value().minorUnits();
+    double indexNs = secondsSince(t0) * 1e9 / indexLookups;
+
+    // Skewed traffic: 60% of lookups go to the top 1% of accounts (every
+    // hundredth one), the rest anywhere. Slot lookups with the bare hash index
+    // against AccountTable::find with its front cache.
+    size_t hotCount = max<size_t>(1, n / 100);
+    vector<int> keys(indexLookups);
+    for (int& k : keys) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        k = x % 100 < 60 ? (int)(x / 100 % hotCount * 100 % n) + 1 : (int)(x / 100 % n) + 1;
+    }
+    AccountTable table;
+    AccountIndex bare;
+    table.reserve(n);
+    bare.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        table.upsert((int)i + 1, "customer", Money(100.0));
+        bare.insert((int)i + 1, (uint32_t)i);
+    }
+    // each key depends on the last result, as the next operation's would; the
+    // same dependency for both (0 unless the previous lookup missed)
+    uint32_t last = 0;
+    for (int k : keys) last = (uint32_t)table.find(k + (int)(last >> 31));   // warm the front cache
+    t0 = Clock::now();
+    for (int k : keys) last = (uint32_t)bare.find(k + (int)(last >> 31));
+    double bareNs = secondsSince(t0) * 1e9 / keys.size();
+    t0 = Clock::now();
+    for (int k : keys) last = (uint32_t)table.find(k + (int)(last >> 31));
+    double cachedNs = secondsSince(t0) * 1e9 / keys.size();
+    sink += (int64_t)last;
+
+    printf("\naccount lookup among %zu accounts\n", n);
+    printf("  %-34s %12.0f ns/lookup\n", "findAccountIndex (linear scan)", linearNs);
+    printf("  %-34s %12.0f ns/lookup\n", "balanceOf (hash index)", indexNs);
+    printf("  %-34s %12.1f ns/lookup\n", "skewed, hash index only", bareNs);
+    printf("  %-34s %12.1f ns/lookup\n", "skewed, with front cache", cachedNs);
+    report.add("lookup", "findAccountIndex", linearNs, "ns");
+    report.add("lookup", "balanceOf", indexNs, "ns");
+    report.add("lookup", "skewed, hash index only", bareNs, "ns");
+    report.add("lookup", "skewed, with front cache", cachedNs, "ns");
+    if (sink == 42) printf(" ");
+}
+
+// Read-heavy mix: balanceOf on every thread but one, which keeps transferring
+// between the same accounts; then a point-in-time export of all of them
+static void readMix(int opsPerThread, size_t n) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    {
+        vector<BankAccount> seed;
+        seed.reserve(n);
+        for (size_t i = 0; i < n; ++i) seed.emplace_back("customer", (int)i + 1, Money(100.0));
+        mgr.saveAllAccounts(seed);
+    }
+    int readers = max(1, (int)thread::hardware_concurrency() - 1);
+    atomic<bool> stop{false};
+    atomic<uint64_t> transfers{0};
+    thread writer([&] {
+        uint64_t x = 1, done = 0;
+        while (!stop.load(memory_order_relaxed)) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            mgr.tryTransfer((int)(x % n) + 1, (int)((x >> 24) % n) + 1, Money::fromMinor(1));
+            ++done;
+        }
+        transfers = done;
+    });
+    vector<thread> pool;
+    Clock::time_point t0 = Clock::now();
+    for (int t = 0; t < readers; ++t) {
+        pool.emplace_back([&, t] {
+            uint64_t x = 88172645463325252ull + t;
+            int64_t sink = 0;
+            for (int k = 0; k < 20 * opsPerThread; ++k) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                sink += mgr.balanceOf((int)(x % n) + 1).value().minorUnits();
+            }
+            if (sink == 42) printf(" ");
+        });
+    }
+    for (auto& th : pool) th.join();
+    double secs = secondsSince(t0);
+    stop = true;
+    writer.join();
+    double readRate = 20.0 * opsPerThread * readers / secs;
+
+    string path = dir.file("export.txt");
+    t0 = Clock::now();
+    mgr.exportAccounts(path);
+    double exportSecs = secondsSince(t0);
+
+    printf("\nreads under concurrent transfers, %zu accounts, %d %s\n", n, readers, readers == 1 ? "reader" : "readers");
+    printf("  %-34s %12.0f reads/s (%.0f transfers/s alongside)\n", "balanceOf", readRate, transfers / secs);
+    printf("  %-34s %10.2f ms\n", "exportAccounts (point in time)", exportSecs * 1e3);
+    report.add("read_mix", "balanceOf", readRate, "reads/s");
+    report.add("read_mix", "exportAccounts", exportSecs * 1e3, "ms");
+}
+
+// Every thread pays into one settlement account: plain vs. split counter
+static void hotAccount(int opsPerThread) {
+    int threads = max(2, (int)thread::hardware_concurrency());
+    printf("\ntransfers into one settlement account, %d threads\n", threads);
+    for (bool hot : {false, true}) {
+        TempDir dir;
+        AccountManager mgr(dir.config());
+        mgr.createAccount(BankAccount("settlement", 1, Money()));
+        for (int t = 0; t < threads; ++t) mgr.createAccount(BankAccount("merchant", 2 + t, Money(1e9)));
+        if (hot) mgr.setHotAccount(1, true);
+        vector<thread> pool;
+        Clock::time_point t0 = Clock::now();
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                for (int k = 0; k < opsPerThread; ++k) {
+                    // a payout now and then exercises the reservation path
+                    if (k % 16 == 15) mgr.tryTransfer(1, 2 + t, Money::fromMinor(100));
+                    else mgr.tryTransfer(2 + t, 1, Money::fromMinor(100));
+                }
+            });
+        }
+        for (auto& th : pool) th.join();
+        double rate = (double)threads * opsPerThread / secondsSince(t0);
+        const char* kind = hot ? "split counter (hot account)" : "single balance";
+        printf("  %-34s %12.0f transfers/s\n", kind, rate);
+        report.add("hot_account", kind, rate, "transfers/s");
+    }
+}
+
+// Onboarding: n createAccount calls in a row, at a small and the default log
+// buffer, then one createAccounts batch
+static void onboarding(size_t n) {
+    printf("\ncreating %zu accounts (buffered log)\n", n);
+    for (size_t bufferSize : {size_t(4096), WriteAheadLog::defaultBufferSize}) {
+        TempDir dir;
+        AccountManagerConfig cfg = dir.config();
+        cfg.logBufferSize = bufferSize;
+        AccountManager mgr(cfg);
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) mgr.createAccount(BankAccount("customer", (int)i + 1, Money(100.0)));
+        mgr.flush();
+        double rate = (double)n / secondsSince(t0);
+        string metric = "createAccount, " + to_string(bufferSize / 1024) + " KiB log buffer";
+        printf("  %-34s %12.0f accounts/s\n", metric.c_str(), rate);
+        report.add("onboarding", metric, rate, "accounts/s");
+    }
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    vector<BankAccount> batch;
+    batch.reserve(n);
+    for (size_t i = 0; i < n; ++i) batch.emplace_back("customer", (int)i + 1, Money(100.0));
+    Clock::time_point t0 = Clock::now();
+    size_t rejected = mgr.createAccounts(batch).size();
+    mgr.flush();
+    double rate = (double)n / secondsSince(t0);
+    t0 = Clock::now();
+    rejected += mgr.createAccounts(batch).size();       // all duplicates this time
+    double dupRate = (double)n / secondsSince(t0);
+    if (rejected != n) throw runtime_error("createAccounts rejected the wrong accounts.");
+    printf("  %-34s %12.0f accounts/s\n", "createAccounts (one batch)", rate);
+    printf("  %-34s %12.0f accounts/s\n", "createAccounts (all duplicates)", dupRate);
+    report.add("onboarding", "createAccounts", rate, "accounts/s");
+    report.add("onboarding", "createAccounts, all duplicates", dupRate, "accounts/s");
+}
+
+// Ledger verification over a log of `records` transfers between 100k accounts,
+// on one thread and on every hardware thread
+static void reconciliation(size_t records) {
+    TempDir dir;
+    AccountManager mgr(dir.config());
+    const int accounts = 100000;
+    vector<BankAccount> seed;
+    seed.reserve(accounts);
+    for (int a = 1; a <= accounts; ++a) seed.emplace_back("customer", a, Money(1e6));
+    mgr.createAccounts(seed);
+    AccountSnapshot baseline = mgr.snapshot();
+    vector<TransferRequest> batch;
+    for (size_t i = 0; i < records; ++i) {
+        batch.push_back({(int)(i * 7919 % accounts) + 1, (int)(i * 104729 % accounts) + 1, Money(1.0)});
+        if (batch.size() == 4096 || i + 1 == records) {
+            mgr.transferBatch(batch);
+            batch.clear();
+        }
+    }
+    printf("\nreconcile a %zu-record log against %d accounts\n", records, accounts);
+    unsigned hw = max(1u, thread::hardware_concurrency());
+    for (unsigned threads : {1u, hw}) {
+        ReconcileConfig cfg;
+        cfg.threads = threads;
+        Clock::time_point t0 = Clock::now();
+        ReconcileReport rep = mgr.reconcile(baseline, cfg);
+        double secs = secondsSince(t0);
+        if (!rep.ok()) throw runtime_error("Reconciliation found differences:\n" + rep.toText());
+        string label = threadsLabel(threads);
+        printf("  %-34s %12.0f records/s\n", label.c_str(), rep.records / secs);
+        report.add("reconcile", label, rep.records / secs, "records/s");
+        if (hw == 1) break;
+    }
+}
+
+// Restart cost with a `records`-transfer log behind the checkpoint, then
+// after compactLog(); plus the archive's size against the text it replaced
+static void logCompaction(size_t records) {
+    TempDir dir;
+    AccountManagerConfig cfg = dir.config();
+    const int accounts = 100000;
+    {
+        AccountManager mgr(cfg);
+        vector<BankAccount> seed;
+        for (int a = 1; a <= accounts; ++a) seed.emplace_back("customer", a, Money(1e6));
+        mgr.createAccounts(seed);
+        mgr.checkpoint();
+        vector<TransferRequest> batch;
+        for (size_t i = 0; i < records; ++i) {
+            batch.push_back({(int)(i * 7919 % accounts) + 1, (int)(i * 104729 % accounts) + 1, Money(1.0 + i % 100)});
+            if (batch.size() == 4096 || i + 1 == records) {
+                mgr.transferBatch(batch);
+                batch.clear();
+            }
+        }
+    }
+    Clock::time_point t0 = Clock::now();
+    CompactionStats st;
+    {
+        AccountManager mgr(cfg);
+        double replaySecs = secondsSince(t0);
+        t0 = Clock::now();
+        st = mgr.compactLog();
+        double compactSecs = secondsSince(t0);
+        printf("\nlog compaction, %zu-record log over %d accounts\n", records, accounts);
+        printf("  %-34s %10.3f ms\n", "open, replaying the log", replaySecs * 1e3);
+        printf("  %-34s %10.3f ms\n", "compactLog", compactSecs * 1e3);
+        report.add("compaction", "open with log replay", replaySecs * 1e3, "ms");
+        report.add("compaction", "compactLog", compactSecs * 1e3, "ms");
+    }
+    t0 = Clock::now();
+    { AccountManager mgr(cfg); }
+    double openSecs = secondsSince(t0);
+    double ratio = st.archiveBytes ? (double)st.logBytesSealed / st.archiveBytes : 0;
+    printf("  %-34s %10.3f ms\n", "open after compaction", openSecs * 1e3);
+    printf("  %-34s %10.1f x (%llu -> %llu bytes)\n", "archive vs text log", ratio,
+           (unsigned long long)st.logBytesSealed, (unsigned long long)st.archiveBytes);
+    report.add("compaction", "open after compaction", openSecs * 1e3, "ms");
+    report.add("compaction", "archive compression", ratio, "x");
+}
+
+// The load generator over 100k accounts with Zipfian skew: flat out on one
+// thread and (with more than one core) on every hardware thread, paced at half the single-thread rate, and a
+// replay of the single-thread run's capture onto a fresh copy of its accounts
+static void workloadMix(size_t ops) {
+    WorkloadConfig w;
+    w.accounts = 100000;
+    w.operations = ops;
+    printf("\nload generator, %zu ops over %d accounts (zipf %.2f, %u/%u/%u transfer/deposit/withdraw, %.0f%% refused)\n",
+           ops, w.accounts, w.zipfSkew, w.transferWeight, w.depositWeight, w.withdrawWeight, w.failureRate * 100);
+    printf("%24s %12s %8s %8s %8s %8s\n", "run", "ops/s", "p50 us", "p99 us", "p99.9 us", "max us");
+    auto row = [](const char* name, const WorkloadReport& r) {
+        printf("%24s %12.0f %8.1f %8.1f %8.1f %8.1f\n", name, r.throughput(), r.latency.percentile(0.5) / 1e3,
+               r.latency.percentile(0.99) / 1e3, r.latency.percentile(0.999) / 1e3, r.latency.maxNanos / 1e3);
+        report.add("workload", string(name) + " throughput", r.throughput(), "ops/s");
+        report.add("workload", string(name) + " p99", r.latency.percentile(0.99) / 1e3, "us");
+    };
+    TempDir traces;
+    string trace = traces.file("capture.trace");
+    WorkloadReport single;
+    {
+        TempDir dir;
+        AccountManager mgr(dir.config());
+        seedWorkloadAccounts(mgr, w);
+        mgr.startCapture(trace);
+        single = runWorkload(mgr, w);
+        mgr.stopCapture();
+        row("1 thread, captured", single);
+    }
+    unsigned hw = max(1u, thread::hardware_concurrency());
+    if (hw > 1) {
+        TempDir dir;
+        AccountManager mgr(dir.config());
+        seedWorkloadAccounts(mgr, w);
+        WorkloadConfig all = w;
+        all.threads = hw;
+        row(threadsLabel(hw).c_str(), runWorkload(mgr, all));
+    }
+    {
+        TempDir dir;
+        AccountManager mgr(dir.config());
+        seedWorkloadAccounts(mgr, w);
+        WorkloadConfig paced = w;
+        paced.targetRate = single.throughput() / 2;
+        row("paced at half rate", runWorkload(mgr, paced));
+    }
+    {
+        TempDir dir;
+        AccountManager mgr(dir.config());
+        seedWorkloadAccounts(mgr, w);
+        WorkloadReport r = replayTrace(mgr, trace);
+        row("replay of the capture", r);
+        printf("  capture: %llu bytes, replay status mismatches: %zu\n",
+               (unsigned long long)fileSize(trace), r.statusMismatches);
+        report.add("workload", "replay status mismatches", (double)r.statusMismatches, "ops");
+    }
+}
+
+static vector<size_t> parseSizes(const string& list) {
+    vector<size_t> sizes;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) comma = list.size();
+        if (comma > start) sizes.push_back((size_t)stoull(list.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    return sizes;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+    int opsPerThread = 20000;
+    size_t scanAccounts = 1000000;
+    vector<size_t> loadSizes = {10000, 1000000, 10000000};
+    string jsonPath, only;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--load-sizes" && i + 1 < argc) loadSizes = bench::parseSizes(argv[++i]);
+        else if (arg == "--only" && i + 1 < argc) only = "," + string(argv[++i]) + ",";
+        else if (positional == 0 && ++positional) opsPerThread = atoi(argv[i]);
+        else if (positional == 1 && ++positional) scanAccounts = (size_t)atoll(argv[i]);
+        else {
+            cerr << "usage: " << argv[0] << " [opsPerThread] [scanAccounts] [--json FILE] [--load-sizes N,N,...]"
+                 << " [--only NAME,...]\n";
+            return 2;
+        }
+    }
+    // names for --only
+    auto want = [&](const char* name) { return only.empty() || only.find("," + string(name) + ",") != string::npos; };
+    try {
+        if (want("scaling")) bench::transferScaling(opsPerThread);
+        if (want("latency")) bench::transferLatency(opsPerThread);
+        if (want("queue")) bench::queueSubmission(opsPerThread);
+        if (want("sharded")) bench::shardedTransfers(opsPerThread);
+        if (want("codec")) bench::recordCodec(scanAccounts);
+        if (want("lookup")) bench::lookupCost(scanAccounts);
+        if (want("reads")) bench::readMix(opsPerThread, scanAccounts);
+        if (want("hot")) bench::hotAccount(opsPerThread);
+        if (want("onboard")) bench::onboarding(min<size_t>(scanAccounts, 100000));
+        if (want("load")) bench::loadScaling(loadSizes);
+        if (want("scans")) bench::balanceScans(scanAccounts);
+        if (want("textload")) bench::textLoad(scanAccounts);
+        if (want("checkpoint")) bench::checkpointCost(scanAccounts);
+        if (want("interest")) bench::interestAccrual(scanAccounts);
+        if (want("history")) bench::historyLookup(scanAccounts);
+        if (want("reconcile")) bench::reconciliation(scanAccounts);
+        if (want("compaction")) bench::logCompaction(scanAccounts);
+        if (want("workload")) bench::workloadMix((size_t)opsPerThread * 10);
+        if (!jsonPath.empty()) bench::report.writeJson(jsonPath);
+    } catch (const exception& e) {
+        cerr << "[Benchmark failed] " << e.what() << "\n";
+        return 1;
     }
     return 0;
 }
+#endif